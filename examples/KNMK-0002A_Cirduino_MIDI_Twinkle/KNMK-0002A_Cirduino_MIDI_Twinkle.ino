@@ -27,6 +27,35 @@ MoePCB Cirno(7);  //インスタンス生成（RGBLED数）
 
 //タイマーにより自動で実行
 void MoePCB_Task(){
+
+  //loop()で受け取ったMIDIはここで反映する（割り込み中にloop()からLEDを触らないように）
+  MoeEvent ev;
+  while(Cirno.event_read(&ev)){
+    if(ev.type==EV_MIDI && (ev.d0&0xF0)==0x90){//まずノートオンのみに絞る
+      if(ev.d2!=0){//ベロシティがゼロではない時（ノートオン＋ベロシティ０でノートオフとする機材もあるため）
+        switch(random(0,6)){
+          case 0:
+            Cirno.rainbow(LED4, 0,   D);  //LED4:レインボーモード,点灯パターンD（強制キラッ）
+          break;
+          case 1:
+            Cirno.rainbow(LED3,60,   D);  //LED3:レインボーモード（位相差60度）
+          break;
+          case 2:
+            Cirno.rainbow(LED2,60*2, D);
+          break;
+          case 3:
+            Cirno.rainbow(LED5,60*3, D);
+          break;
+          case 4:
+            Cirno.rainbow(LED6,60*4, D);
+          break;
+          case 5:
+            Cirno.rainbow(LED7,60*5, D);
+          break;
+        }
+      }
+    }
+  }
   
   //光らせたいパターンを選んでLEDのIDをセットすると自動で処理
   Cirno.breath (LED1);          //LED1:裏面RGBLED
@@ -43,7 +72,8 @@ void MoePCB_Task(){
 void setup() {
 //  Serial.begin(9600);//シリアル通信を使いたいとき
 
-  Cirno.begin();//萌基板初期化
+  Cirno.begin(true);//萌基板初期化 タイマーで自動実行
+  Cirno.beat_lock(4);//4拍で呼吸・虹色が一周するようMIDIのテンポに合わせる
 
 }
 
@@ -66,30 +96,7 @@ void loop() {
     Serial.print("-");
     Serial.println(rx.byte3);
 */
-      if(rx.header==9){//まずノートオンのみに絞る（９）
-        if(rx.byte3!=0){//ベロシティがゼロではない時（ノートオン＋ベロシティ０でノートオフとする機材もあるため）
-          switch(random(0,6)){
-            case 0:
-              Cirno.rainbow(LED4, 0,   D);  //LED4:レインボーモード,点灯パターンD（強制キラッ）
-            break;
-            case 1:
-              Cirno.rainbow(LED3,60,   D);  //LED3:レインボーモード（位相差60度）
-            break;
-            case 2:
-              Cirno.rainbow(LED2,60*2, D);
-            break;
-            case 3:
-              Cirno.rainbow(LED5,60*3, D);
-            break;
-            case 4:
-              Cirno.rainbow(LED6,60*4, D);
-            break;
-            case 5:
-              Cirno.rainbow(LED7,60*5, D);
-            break;
-          }
-        }
-      }
+      Cirno.midi_input(rx.byte1, rx.byte2, rx.byte3);//テンポ検出とキラッ（MoePCB_Taskで受け取る）
     }
   } while (rx.header != 0);
     
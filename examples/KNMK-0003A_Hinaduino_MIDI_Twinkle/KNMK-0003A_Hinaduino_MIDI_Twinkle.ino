@@ -27,6 +27,44 @@ MoePCB Hina(10);  //インスタンス生成（RGBLED数）
 
 //タイマーにより自動で実行
 void MoePCB_Task(){
+
+  //loop()で受け取ったMIDIはここで反映する（割り込み中にloop()からLEDを触らないように）
+  MoeEvent ev;
+  while(Hina.event_read(&ev)){
+    if(ev.type==EV_MIDI && (ev.d0&0xF0)==0x90){//まずノートオンのみに絞る
+      if(ev.d2!=0){//ベロシティがゼロではない時（ノートオン＋ベロシティ０でノートオフとする機材もあるため）
+        switch(random(0,10)){
+          case 0:
+            Hina.rainbow(LED5, 0,   D);  //LED4:レインボーモード,点灯パターンD（強制キラッ）
+          break;
+          case 1:
+            Hina.rainbow(LED4,60,   D);  //LED3:レインボーモード（位相差60度）
+          break;
+          case 2:
+            Hina.rainbow(LED3,60*2, D);
+          break;
+          case 3:
+            Hina.rainbow(LED2,60*3, D);
+          break;
+          case 4:
+            Hina.rainbow(LED10,60*4, D);
+          break;
+          case 5:
+            Hina.rainbow(LED9,60*5, D);
+          break;
+          case 6:
+            Hina.rainbow(LED8,60*6, D);
+          break;
+          case 7:
+            Hina.rainbow(LED7,60*7, D);
+          break;
+          case 8:
+            Hina.rainbow(LED6,60*8, D);
+          break;
+        }
+      }
+    }
+  }
   
   //光らせたいパターンを選んでLEDのIDをセットすると自動で処理
   Hina.breath (LED1);          //LED1:裏面RGBLED
@@ -46,7 +84,8 @@ void MoePCB_Task(){
 void setup() {
 //  Serial.begin(9600);//シリアル通信を使いたいとき
 
-  Hina.begin();//萌基板初期化
+  Hina.begin(true);//萌基板初期化 タイマーで自動実行
+  Hina.beat_lock(4);//4拍で呼吸・虹色が一周するようMIDIのテンポに合わせる
 
 }
 
@@ -69,39 +108,7 @@ void loop() {
     Serial.print("-");
     Serial.println(rx.byte3);
 */
-      if(rx.header==9){//まずノートオンのみに絞る（９）
-        if(rx.byte3!=0){//ベロシティがゼロではない時（ノートオン＋ベロシティ０でノートオフとする機材もあるため）
-          switch(random(0,10)){
-            case 0:
-              Hina.rainbow(LED5, 0,   D);  //LED4:レインボーモード,点灯パターンD（強制キラッ）
-            break;
-            case 1:
-              Hina.rainbow(LED4,60,   D);  //LED3:レインボーモード（位相差60度）
-            break;
-            case 2:
-              Hina.rainbow(LED3,60*2, D);
-            break;
-            case 3:
-              Hina.rainbow(LED2,60*3, D);
-            break;
-            case 4:
-              Hina.rainbow(LED10,60*4, D);
-            break;
-            case 5:
-              Hina.rainbow(LED9,60*5, D);
-            break;
-            case 6:
-              Hina.rainbow(LED8,60*6, D);
-            break;
-            case 7:
-              Hina.rainbow(LED7,60*7, D);
-            break;
-            case 8:
-              Hina.rainbow(LED6,60*8, D);
-            break;
-          }
-        }
-      }
+      Hina.midi_input(rx.byte1, rx.byte2, rx.byte3);//テンポ検出とキラッ（MoePCB_Taskで受け取る）
     }
   } while (rx.header != 0);
     
@@ -27,6 +27,34 @@ MoePCB Tenshi(16);  //インスタンス生成（RGBLED数）
 
 //タイマーにより自動で実行
 void MoePCB_Task(){
+
+  //loop()で受け取ったMIDIはここで反映する（割り込み中にloop()からLEDを触らないように）
+  MoeEvent ev;
+  while(Tenshi.event_read(&ev)){
+    if(ev.type==EV_MIDI && (ev.d0&0xF0)==0x90){//まずノートオンのみに絞る
+      if(ev.d2!=0){//ベロシティがゼロではない時（ノートオン＋ベロシティ０でノートオフとする機材もあるため）
+        Tenshi.lvmeter_input(map(ev.d2,0,127,0,280));//メーターに反映
+
+        switch(random(0,6)){
+          case 0:
+            Tenshi.rainbow(LED4, 0,   D);  //LED4:レインボーモード,点灯パターンD（強制キラッ）
+          break;
+          case 1:
+            Tenshi.rainbow(LED3,60,   D);  //LED3:レインボーモード（位相差60度）
+          break;
+          case 2:
+            Tenshi.rainbow(LED2,60*2, D);
+          break;
+          case 3:
+            Tenshi.rainbow(LED5,60*3, D);
+          break;
+          case 4:
+            Tenshi.rainbow(LED6,60*4, D);
+          break;
+        }
+      }
+    }
+  }
   
   //光らせたいパターンを選んでLEDのIDをセットすると自動で処理
   Tenshi.breath (LED1);          //LED1:裏面RGBLED
@@ -53,7 +81,8 @@ void MoePCB_Task(){
 void setup() {
 //  Serial.begin(9600);//シリアル通信を使いたいとき
 
-  Tenshi.begin();//萌基板初期化
+  Tenshi.begin(true);//萌基板初期化 タイマーで自動実行
+  Tenshi.beat_lock(4);//4拍で呼吸・虹色が一周するようMIDIのテンポに合わせる
 
 }
 
@@ -76,29 +105,7 @@ void loop() {
     Serial.print("-");
     Serial.println(rx.byte3);
 */
-      if(rx.header==9){//まずノートオンのみに絞る（９）
-        if(rx.byte3!=0){//ベロシティがゼロではない時（ノートオン＋ベロシティ０でノートオフとする機材もあるため）
-          Tenshi.lvmeter_input(map(rx.byte3,0,127,0,280));//メーターに反映
-
-          switch(random(0,6)){
-            case 0:
-              Tenshi.rainbow(LED4, 0,   D);  //LED4:レインボーモード,点灯パターンD（強制キラッ）
-            break;
-            case 1:
-              Tenshi.rainbow(LED3,60,   D);  //LED3:レインボーモード（位相差60度）
-            break;
-            case 2:
-              Tenshi.rainbow(LED2,60*2, D);
-            break;
-            case 3:
-              Tenshi.rainbow(LED5,60*3, D);
-            break;
-            case 4:
-              Tenshi.rainbow(LED6,60*4, D);
-            break;
-          }
-        }
-      }
+      Tenshi.midi_input(rx.byte1, rx.byte2, rx.byte3);//テンポ検出とキラッ（MoePCB_Taskで受け取る）
     }
   } while (rx.header != 0);
     
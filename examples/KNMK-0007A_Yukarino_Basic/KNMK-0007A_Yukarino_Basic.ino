@@ -32,6 +32,12 @@
 #define RIBBON_R A3  // スキマ右リボン
 #define RIBBON_L A0  // スキマ左リボン
 
+// タッチイベントのチャンネル　loop()からMoePCB_Taskへ送る
+#define TOUCH_MUNE 0
+#define TOUCH_SKIRT 1
+#define TOUCH_RIBBON_R 2
+#define TOUCH_RIBBON_L 3
+
 // IRプロトコル解析-NEC
 #define DECODE_NEC
 
@@ -42,13 +48,19 @@ int skirt_offset;
 int ribbon_R_offset;
 int ribbon_L_offset;
 
-// タッチセンシングフラグ
+// タッチセンシングフラグ（loop()側で立ち上がり・立ち下がりを見る用）
 bool kami_flag;  
 bool mune_flag;
 bool skirt_flag;
 bool ribbon_R_flag;
 bool ribbon_L_flag;
 
+// ここから下はMoePCB_Taskだけが書き換える　loop()からはイベントで伝える
+// タッチ状態
+bool mune_touch;
+bool ribbon_R_touch;
+bool ribbon_L_touch;
+
 // 他の誰かがIRを発していることを検出する 保持タイマーも兼ねてる
 int ir_detectflag = 0;
 // 誰かが怒りモード担っているのを検出する　保持タイマーも兼ねてる
@@ -61,28 +73,27 @@ int musou_detectflag = 0;
 int musou_gauge = 0;
 
 uint8_t PATTERN_MODE = 0;  // 点灯パターン 0-2
+uint8_t LAST_PATTERN_MODE = 0;  // クロスフェード元の点灯パターン
+// 最後に触られたリボン　フェードアウト中も保持する
+bool spark_L_flag;
+bool spark_R_flag;
 
 #define NO_LED_FEEDBACK_CODE  // IR saves 418 bytes program space
 #include <IRremote.hpp>
 
-  //紫特有の単色LED用
+  //紫特有の単色LED用　萌基板ライブラリの補助チャンネルで光らせる
   int BLUE_LED_pin =9;//5,[9],[10],[11] 5は駄目だった 11だけ周波数が高い
   int RED_LED_pin =10;
-  int BLUE_LED_power=0;
-  int RED_LED_power=0;
+  #define BLUE_LED AUX1
+  #define RED_LED AUX2
   int nomal_LED_cnt=0;
-  //LED用PWMパワーを50段階で計算したもの。対数
-  const int LED_POWER[]={0,3,4,5,7,8,9,11,12,14,15,17,19,20,22,24,26,27,29,31,33,35,38,40,42,45,47,50,53,56,59,62,65,68,72,76,80,85,89,95,100,106,113,121,129,139,151,166,184,210,255};//
 
 MoePCB Yukari(14);  // インスタンス生成（RGBLED数）
+const uint8_t SUKIMA_EYES[] = {LED5, LED4, LED3, LED14, LED13, LED12};  // すきまお目々
 
-// タイマーにより自動で実行
-void MoePCB_Task() {
-
-
-
-  
-  switch (PATTERN_MODE) {
+// 点灯パターンを描く
+void draw_pattern(uint8_t mode) {
+  switch (mode) {
       // 点灯パターン１
     case 0:
       pattern1();
@@ -96,12 +107,12 @@ void MoePCB_Task() {
       // 点灯パターン３：ゲーミングモード
     case 2:
       //単色LEDには交互に最大輝度を与えてる
-      if(nomal_LED_cnt==0)BLUE_LED_power=20;
-      if(nomal_LED_cnt==1)BLUE_LED_power=35;
-      if(nomal_LED_cnt==2)BLUE_LED_power=50;
-      if(nomal_LED_cnt==51)RED_LED_power=20;
-      if(nomal_LED_cnt==52)RED_LED_power=35;
-      if(nomal_LED_cnt==53)RED_LED_power=50;
+      if(nomal_LED_cnt==0)Yukari.aux_flash(BLUE_LED, 100);
+      if(nomal_LED_cnt==1)Yukari.aux_flash(BLUE_LED, 180);
+      if(nomal_LED_cnt==2)Yukari.aux_flash(BLUE_LED, 255);
+      if(nomal_LED_cnt==51)Yukari.aux_flash(RED_LED, 100);
+      if(nomal_LED_cnt==52)Yukari.aux_flash(RED_LED, 180);
+      if(nomal_LED_cnt==53)Yukari.aux_flash(RED_LED, 255);
       nomal_LED_cnt++;
       if(100<nomal_LED_cnt)nomal_LED_cnt=0;
 
@@ -121,66 +132,113 @@ void MoePCB_Task() {
       Yukari.gaming(LED9, 220);
       break;
   }
+}
 
-  while (!IrReceiver.isIdle())
-    ;  // IR受信状態がアイドル状態になるまで待つ　NeoPixel処理は割り込みハンドラを阻害するため
-  Yukari.update();  // 計算＆LEDに送信
+// loop()から届いたイベントを反映する
+void read_events() {
+  MoeEvent ev;
+  while (Yukari.event_read(&ev)) {  // 明るさ変更はライブラリ側で反映済み
+    if (ev.type == EV_TOUCH) {
+      if (ev.d0 == TOUCH_MUNE) mune_touch = ev.d1;
+      if (ev.d0 == TOUCH_RIBBON_R) ribbon_R_touch = ev.d1;
+      if (ev.d0 == TOUCH_RIBBON_L) ribbon_L_touch = ev.d1;
+      // スカートタッチで点灯パターン切り替え
+      if ((ev.d0 == TOUCH_SKIRT) && ev.d1) {
+        if (PATTERN_MODE == 0)
+          PATTERN_MODE = 1;
+        else if (PATTERN_MODE == 1)
+          PATTERN_MODE = 2;
+        else
+          PATTERN_MODE = 0;
+        // 新しいパターンを0.5秒かけてクロスフェード
+        Yukari.layer_fade(LAYER_OVER1, 0, 0);
+        Yukari.layer_fade(LAYER_OVER1, 255, 25);
+      }
+    }
+    if (ev.type == EV_IR) {
+      // 自分以外の誰かが居ることを検出
+      // 未開発だけどID64までとりあえず認識する
+      if ((ev.d0 != YUKARI) && (0 < ev.d0) && (ev.d0 < 64)) {
+        ir_detectflag = 50 * 4;  // 4秒ほど見つからなければ自動でゼロへ
+        // 自分以外の誰かが怒りモードになってる
+        if (ev.d1 == ANGRY) {
+          ir_angry_detectflag = 50 * 3;  // 3秒ほど維持する
+        }
+      }
+    }
+  }
 
+  // 誰かがいればIRフラグが経つ　しばらく見つからなければフラグは減っていきゼロへ
+  if (0 < ir_detectflag) ir_detectflag--;
 
+  // 誰かが怒っていればいればIR怒りフラグが経つ　しばらく見つからなければフラグは減っていきゼロへ
+  if (0 < ir_angry_detectflag) ir_angry_detectflag--;
 
-  //単色LED操作コーナー ***********************************************
-  //怒りを検出したとき
-  if(0<Yukari.Get_FuryGauge()){
-    //怒りはじめ
-    if(Yukari.Get_FuryGauge()<250){
-      BLUE_LED_power=map(Yukari.Get_FuryGauge(),0,255,0,50);
-      RED_LED_power=map(Yukari.Get_FuryGauge(),0,255,0,50);
-    }else{
-    //怒りきったとき・脈動を拾ってきて入れる
-      if(Yukari.Get_pulsation() < 20 )BLUE_LED_power=50;
-      if(Yukari.Get_pulsation() < 20 )RED_LED_power=50;
+  // 霊夢がいればフラグが経つ　しばらく見つからなければフラグは減っていきゼロへ
+  if (0 < reimu_detectflag) reimu_detectflag--;
+
+  // 夢想封印検出フラグ
+  if (0 < musou_detectflag) musou_detectflag--;
+
+  // 夢想封印検出しなくなったらゲージを自動でへらす
+  if (musou_detectflag == 0) {
+    if (0 < musou_gauge) musou_gauge -= 1;
+  }
+
+  // 胸タッチ、あるいは誰かがIR越しに怒っていることを検出したら怒る
+  // どちらでもなければ怒りをおさめる
+  Yukari.angry(mune_touch || (ir_angry_detectflag != 0));
+}
+
+// タイマーにより自動で実行
+void MoePCB_Task() {
+  read_events();
+
+
+  // 点灯パターン切り替え中は新しいパターンをオーバーレイ１に描いてクロスフェード
+  bool handoff = false;
+  if (LAST_PATTERN_MODE != PATTERN_MODE) {
+    Yukari.layer(LAYER_OVER1);
+    draw_pattern(PATTERN_MODE);
+    // フェードが終わったらベースに引き継いでオーバーレイは透明に戻す
+    if (Yukari.Get_layer_alpha(LAYER_OVER1) == 255) {
+      Yukari.layer_copy(LAYER_BASE, LAYER_OVER1);
+      Yukari.layer_fade(LAYER_OVER1, 0, 0);
+      LAST_PATTERN_MODE = PATTERN_MODE;
+      handoff = true;
     }
-  }  
-  //紫特有の単色LED、スムージング操作 パワーは0-50　上の方にある配列使って対数0-255に直してAnalogWriteしてる
-  BLUE_LED_power--;
-  RED_LED_power--;
-  if( 50<BLUE_LED_power )BLUE_LED_power=50;
-  if( 50<RED_LED_power  )RED_LED_power=50;
-  if( BLUE_LED_power<0 )BLUE_LED_power=0;
-  if( RED_LED_power <0 )RED_LED_power=0;
-
-  if(PATTERN_MODE==2){ 
-    if(Yukari.brightness==0){
-      analogWrite(BLUE_LED_pin, LED_POWER[BLUE_LED_power]/2);
-      analogWrite(RED_LED_pin, LED_POWER[RED_LED_power]/2);
-    }else{
-      analogWrite(BLUE_LED_pin, LED_POWER[BLUE_LED_power]);
-      analogWrite(RED_LED_pin, LED_POWER[RED_LED_power]);
-    }    
-  }else{
-    if(Yukari.brightness==0){
-      analogWrite(BLUE_LED_pin, LED_POWER[BLUE_LED_power]/4);
-      analogWrite(RED_LED_pin, LED_POWER[RED_LED_power]/4);
-    }else if(Yukari.brightness==1){
-      analogWrite(BLUE_LED_pin, LED_POWER[BLUE_LED_power]/2);
-      analogWrite(RED_LED_pin, LED_POWER[RED_LED_power]/2);
-    }else{
-      analogWrite(BLUE_LED_pin, LED_POWER[BLUE_LED_power]);
-      analogWrite(RED_LED_pin, LED_POWER[RED_LED_power]);
-    }    
   }
-  
-  
+  // 引き継いだフレームはオーバーレイで描いた分をそのまま使う
+  // 同じパターンを２回描くとカウンタや減衰が１フレームで２回進んでしまう
+  if (!handoff) {
+    Yukari.layer(LAYER_BASE);
+    draw_pattern(LAST_PATTERN_MODE);
+  }
+
+  // リボンを触っている間は単色LEDを点ける（ゲーミングモード以外）
+  // 怒ったときの点灯と明るさ設定はライブラリ側で反映される
+  Yukari.aux(BLUE_LED, ((PATTERN_MODE != 2) && ribbon_L_touch) ? 255 : 0);
+  Yukari.aux(RED_LED, ((PATTERN_MODE != 2) && ribbon_R_touch) ? 255 : 0);
 
-  //単色LED操作コーナー ***********************************************
+  // リボンタッチの演出はオーバーレイ２でフェードイン・アウト
+  if (PATTERN_MODE != 2) ribbon_overlay();
 
+  while (!IrReceiver.isIdle())
+    ;  // IR受信状態がアイドル状態になるまで待つ　NeoPixel処理は割り込みハンドラを阻害するため
+  Yukari.update();  // 計算＆LEDに送信
 }
 
 void setup() {
   //  Serial.begin(9600);  // シリアル通信を使いたいとき
   //  while(!Serial);
 
+  Yukari.board(YUKARI);  // LEDの並びから位相マップを作る
   Yukari.begin();  // 萌基板初期化 タイマー無効で開始
+  Yukari.layer_begin(LAYER_OVER1, BLEND_NORMAL);  // 点灯パターン切り替え用
+  Yukari.layer_begin(LAYER_OVER2, BLEND_NORMAL);  // リボンタッチ演出用
+  Yukari.aux_begin(BLUE_LED, BLUE_LED_pin);  // 紫特有の単色LED
+  Yukari.aux_begin(RED_LED, RED_LED_pin);
+  //  Yukari.power_limit(400);  // モバイルバッテリーなどで落ちるときはRGBLEDの電流(mA)を制限する
 
   IrSender.begin(3);    // IRremoteはD3から出力する
   IrReceiver.begin(2);  // D2で受信
@@ -191,6 +249,9 @@ void setup() {
   skirt_offset = ADCTouch.read(SKIRT, 500);
   ribbon_R_offset = ADCTouch.read(RIBBON_R, 500);
   ribbon_L_offset = ADCTouch.read(RIBBON_L, 500);
+
+  // 入力を記録するとき（書き出した記録はextras/replayでPC上に再生できる）
+  //  Yukari.trace_begin(512);  // 記録に使うバイト数　1フレーム1バイト＋イベント5バイト
 }
 
 void loop() {
@@ -226,10 +287,15 @@ void loop() {
   //  Serial.println(mune_sense);
   //  Serial.println(skirt_sense);
 
+  //  入力の記録を書き出したいとき　シリアルに'd'を送る
+  //  if (Serial.available() && (Serial.read() == 'd')) Yukari.trace_dump(Serial);
+
   // 髪タッチ検知
   if (50 < kami_sense) {
     // フラグがまだ立っていなければ以下を実行
-    if (kami_flag == 0) Yukari.brightness_add();
+    if (kami_flag == 0) {
+      Yukari.brightness_add();  // 明るさを１段階追加
+    }
     kami_flag = 1;  // フラグを立てることで立ち上がり時のみ実行
   } else
     kami_flag = 0;  // 離したのでタッチフラグクリア
@@ -240,16 +306,11 @@ void loop() {
     if (mune_flag == 0) {
       // 胸タッチ検出IRをワンショット送る
       IR_send(ANGRY, Yukari.Get_FuryGauge());
+      Yukari.event_post(EV_TOUCH, TOUCH_MUNE, 1, 0);
     }
-    Yukari.angry(true);
     mune_flag = 1;  // フラグを立てることで立ち上がり時のみ実行
   } else {
-    // あるいは誰かがIR越しに怒っていることを検出したら怒る
-    if (ir_angry_detectflag != 0)
-      Yukari.angry(true);
-    else
-      // 胸タッチしていない、かつIRでも誰でも怒っていなければ怒りをおさめる
-      Yukari.angry(false);
+    if (mune_flag == 1) Yukari.event_post(EV_TOUCH, TOUCH_MUNE, 0, 0);
     mune_flag = 0;  // 離したのでタッチフラグクリア
   }
 
@@ -257,13 +318,8 @@ void loop() {
   if (50 < skirt_sense) {
     // フラグがまだ立っていなければ以下を実行
     if (skirt_flag == 0) {
-      Yukari.acknowledge();  // 了解コール
-      if (PATTERN_MODE == 0)
-        PATTERN_MODE = 1;
-      else if (PATTERN_MODE == 1)
-        PATTERN_MODE = 2;
-      else
-        PATTERN_MODE = 0;
+      // 了解コールの暗転はせず、切り替えはクロスフェードで見せる
+      Yukari.event_post(EV_TOUCH, TOUCH_SKIRT, 1, 0);  // 点灯パターン切り替え
     }
     skirt_flag = 1;  // フラグを立てることで立ち上がり時のみ実行
   } else {
@@ -279,9 +335,11 @@ void loop() {
     if (ribbon_R_flag == 0) {
       // タッチ検出IRをワンショット送る
       IR_send(RIBBON_R, Yukari.Get_FuryGauge());
+      Yukari.event_post(EV_TOUCH, TOUCH_RIBBON_R, 1, 0);
     }
     ribbon_R_flag = 1;  // フラグを立てることで立ち上がり時のみ実行
   } else {
+    if (ribbon_R_flag == 1) Yukari.event_post(EV_TOUCH, TOUCH_RIBBON_R, 0, 0);
     ribbon_R_flag = 0;  // 離したのでタッチフラグクリア
   }
 
@@ -291,17 +349,21 @@ void loop() {
     if (ribbon_L_flag == 0) {
       // タッチ検出IRをワンショット送る
       IR_send(RIBBON_L, Yukari.Get_FuryGauge());
+      Yukari.event_post(EV_TOUCH, TOUCH_RIBBON_L, 1, 0);
     }
     ribbon_L_flag = 1;  // フラグを立てることで立ち上がり時のみ実行
   } else {
+    if (ribbon_L_flag == 1) Yukari.event_post(EV_TOUCH, TOUCH_RIBBON_L, 0, 0);
     ribbon_L_flag = 0;  // 離したのでタッチフラグクリア
   }
   
 
   // IR関係
   // 状態送信
+  // 送信間隔のばらつきはmicros()の下位ビットから作る
+  // random()はパターン側と同じ乱数列なので、ここで引くとextras/replayの再生とずれる
   static int IR_cnt = 0;
-  if (100 + random(0, 5) < IR_cnt) {
+  if (100 + (int)((micros() >> 2) % 5) < IR_cnt) {
     IR_cnt = 0;
     if (50 < mune_sense) {
       IR_send(ANGRY, Yukari.Get_FuryGauge());  // 胸タッチ検出
@@ -311,23 +373,6 @@ void loop() {
   }
   IR_cnt++;
 
-  // 誰かがいればIRフラグが経つ　しばらく見つからなければフラグは減っていきゼロへ
-  if (0 < ir_detectflag) ir_detectflag--;
-
-  // 誰かが怒っていればいればIR怒りフラグが経つ　しばらく見つからなければフラグは減っていきゼロへ
-  if (0 < ir_angry_detectflag) ir_angry_detectflag--;
-
-  // 霊夢がいればフラグが経つ　しばらく見つからなければフラグは減っていきゼロへ
-  if (0 < reimu_detectflag) reimu_detectflag--;
-
-  // 夢想封印検出フラグ
-  if (0 < musou_detectflag) musou_detectflag--;
-
-  // 夢想封印検出しなくなったらゲージを自動でへらす
-  if (musou_detectflag == 0) {
-    if (0 < musou_gauge) musou_gauge -= 1;
-  }
-
   MoePCB_Task();  // 萌基板タスク
 
   // IR受信データがあればデコード関数へ
@@ -366,18 +411,8 @@ void IR_decode() {
         Serial.print(",   data= ");
         Serial.println(data);
     */
-    // 自分以外の誰かが居ることを検出
-    if (ID != YUKARI) {
-      // 未開発だけどID64までとりあえず認識する
-      if ((0 < ID) && (ID < 64)) {
-        ir_detectflag = 50 * 4;  // 4秒ほど見つからなければ自動でゼロへ
-
-        // 自分以外の誰かが怒りモードになってる
-        if (command == ANGRY) {
-          ir_angry_detectflag = 50 * 3;  // 3秒ほど維持する
-        }
-      }
-    }
+    // 誰が居るかの判定はMoePCB_Taskで行う
+    Yukari.event_post(EV_IR, ID, command, data);
   }
   IrReceiver.resume();  // Enable receiving of the next value
 }
@@ -385,7 +420,7 @@ void IR_decode() {
 void pattern2() {
 
   //  誰かを見つけると裏側のLEDをシアンに光らせる
-  if((ribbon_L_flag)||(ribbon_R_flag)){
+  if((ribbon_L_touch)||(ribbon_R_touch)){
     Yukari.cyanbreath(LED1);
     Yukari.cyanbreath(LED2);
   }else if (ir_detectflag != 0) {
@@ -396,73 +431,30 @@ void pattern2() {
     Yukari.mute(LED2);
   }
 
-  //******************************
-  
-  if(ribbon_L_flag){
-    if(BLUE_LED_power < 51 )BLUE_LED_power+=(2+Yukari.brightness);
-  }
-  if(ribbon_R_flag){
-    if(RED_LED_power < 51 )RED_LED_power+=(2+Yukari.brightness);
-  }
-  //******************************
-  
   //傘
-  if((ribbon_L_flag)&&(ribbon_R_flag)){
-    Yukari.gaming(LED6,  10 * 100);
-    Yukari.gaming(LED7,  10 * 60);
-    Yukari.gaming(LED8,  10 * 20);
-    Yukari.gaming(LED9,  10 * 0);
-    Yukari.gaming(LED10, 10 * 40);
-    Yukari.gaming(LED11, 10 * 80);
-  }else{
-    Yukari.rainbow(LED6,  10 * 0, A);
-    Yukari.rainbow(LED7,  10 * 1, A);
-    Yukari.rainbow(LED8,  10 * 2, A);
-    Yukari.rainbow(LED9,  10 * 3, A);
-    Yukari.rainbow(LED10, 10 * 4, A);
-    Yukari.rainbow(LED11, 10 * 5, A);
-  }
+  Yukari.rainbow(LED6,  10 * 0, A);
+  Yukari.rainbow(LED7,  10 * 1, A);
+  Yukari.rainbow(LED8,  10 * 2, A);
+  Yukari.rainbow(LED9,  10 * 3, A);
+  Yukari.rainbow(LED10, 10 * 4, A);
+  Yukari.rainbow(LED11, 10 * 5, A);
   
   //単色LEDランダムぴかぴか******************************
-  int set_LED_POWER;
-  if(!random(0, 400))BLUE_LED_power=50;
-  if(!random(0, 400))RED_LED_power=50;
+  if(!random(0, 400))Yukari.aux_flash(BLUE_LED, 255);
+  if(!random(0, 400))Yukari.aux_flash(RED_LED, 255);
   //単色LEDランダムぴかぴか******************************
 
   //すきまお目々
-  if((ribbon_L_flag)&&(ribbon_R_flag)){
-    Yukari.masterspark(LED5, 0);
-    Yukari.masterspark(LED4, 4);
-    Yukari.masterspark(LED3, 8);
-    Yukari.masterspark(LED14, 10);
-    Yukari.masterspark(LED13, 6);
-    Yukari.masterspark(LED12, 2);
-  }else if(ribbon_L_flag){
-    Yukari.masterspark(LED5, 0);
-    Yukari.masterspark(LED4, 3);
-    Yukari.masterspark(LED3, 6);
-    Yukari.masterspark(LED14, 9);
-    Yukari.masterspark(LED13, 12);
-    Yukari.masterspark(LED12, 15);
-  }else if(ribbon_R_flag){
-    Yukari.masterspark(LED5, 15);
-    Yukari.masterspark(LED4, 12);
-    Yukari.masterspark(LED3, 9);
-    Yukari.masterspark(LED14, 6);
-    Yukari.masterspark(LED13, 3);
-    Yukari.masterspark(LED12, 0);
-  }else{
-    Yukari.marisa_twinkle( LED5,  0);
-    Yukari.marisa_twinkle( LED4, 20);
-    Yukari.marisa_twinkle( LED3, 10);
-    Yukari.marisa_twinkle( LED14, 30);
-    Yukari.marisa_twinkle(LED13, 40);
-    Yukari.marisa_twinkle(LED12, 50);
-  }
+  Yukari.marisa_twinkle( LED5,  0);
+  Yukari.marisa_twinkle( LED4, 20);
+  Yukari.marisa_twinkle( LED3, 10);
+  Yukari.marisa_twinkle( LED14, 30);
+  Yukari.marisa_twinkle(LED13, 40);
+  Yukari.marisa_twinkle(LED12, 50);
 }
 void pattern1() {      // 魔理沙を認識したら同じ光パターンへ
   //  誰かを見つけると裏側のLEDをシアンに光らせる
-  if((ribbon_L_flag)||(ribbon_R_flag)){
+  if((ribbon_L_touch)||(ribbon_R_touch)){
     Yukari.cyanbreath(LED1);
     Yukari.cyanbreath(LED2);
   }else if (ir_detectflag != 0) {
@@ -473,68 +465,72 @@ void pattern1() {      // 魔理沙を認識したら同じ光パターンへ
     Yukari.mute(LED2);
   }
 
-  //******************************
-  
-  if(ribbon_L_flag){
-    if(BLUE_LED_power < 51 )BLUE_LED_power+=(2+Yukari.brightness);
-  }
-  if(ribbon_R_flag){
-    if(RED_LED_power < 51 )RED_LED_power+=(2+Yukari.brightness);
+  //傘
+  Yukari.icy(LED6, A);
+  Yukari.icy(LED7, A);
+  Yukari.icy(LED8, A);
+  Yukari.icy(LED9, A);
+  Yukari.icy(LED10, A);
+  Yukari.icy(LED11, A);
+
+  //単色LEDランダムぴかぴか******************************
+  if(!random(0, 1000))Yukari.aux_flash(BLUE_LED, 255);
+  if(!random(0, 1000))Yukari.aux_flash(RED_LED, 255);
+  //単色LEDランダムぴかぴか******************************
+
+
+  //すきまお目々
+  Yukari.marisa_twinkle( LED5,  0);
+  Yukari.marisa_twinkle( LED4, 20);
+  Yukari.marisa_twinkle( LED3, 10);
+  Yukari.marisa_twinkle( LED14, 30);
+  Yukari.marisa_twinkle(LED13, 40);
+  Yukari.marisa_twinkle(LED12, 50);
+}
+
+// リボンタッチの演出　オーバーレイ２に描いてフェードで重ねる
+void ribbon_overlay() {
+  // 触っている間はすぐ重ねて、離したら0.5秒かけて消す
+  if((ribbon_L_touch)||(ribbon_R_touch)){
+    spark_L_flag = ribbon_L_touch;
+    spark_R_flag = ribbon_R_touch;
+    Yukari.layer_fade(LAYER_OVER2, 255, 5);
+  }else if((spark_L_flag)||(spark_R_flag)){
+    Yukari.layer_fade(LAYER_OVER2, 0, 25);
+    if(Yukari.Get_layer_alpha(LAYER_OVER2) == 0){
+      spark_L_flag = 0;
+      spark_R_flag = 0;
+    }
   }
-  //******************************
-  
+  if((!spark_L_flag)&&(!spark_R_flag)) return;
+
+  Yukari.layer(LAYER_OVER2);
+
   //傘
-  if((ribbon_L_flag)&&(ribbon_R_flag)){
+  if((spark_L_flag)&&(spark_R_flag)){
     Yukari.gaming(LED6,  10 * 100);
     Yukari.gaming(LED7,  10 * 60);
     Yukari.gaming(LED8,  10 * 20);
     Yukari.gaming(LED9,  10 * 0);
     Yukari.gaming(LED10, 10 * 40);
     Yukari.gaming(LED11, 10 * 80);
-  }else{
-    Yukari.icy(LED6, A);
-    Yukari.icy(LED7, A);
-    Yukari.icy(LED8, A);
-    Yukari.icy(LED9, A);
-    Yukari.icy(LED10, A);
-    Yukari.icy(LED11, A);
   }
 
-  //単色LEDランダムぴかぴか******************************
-  int set_LED_POWER;
-  if(!random(0, 1000))BLUE_LED_power=50;
-  if(!random(0, 1000))RED_LED_power=50;
-  //単色LEDランダムぴかぴか******************************
-
-
   //すきまお目々
-  if((ribbon_L_flag)&&(ribbon_R_flag)){
+  if((spark_L_flag)&&(spark_R_flag)){
     Yukari.masterspark(LED5, 0);
     Yukari.masterspark(LED4, 4);
     Yukari.masterspark(LED3, 8);
     Yukari.masterspark(LED14, 10);
     Yukari.masterspark(LED13, 6);
     Yukari.masterspark(LED12, 2);
-  }else if(ribbon_L_flag){
-    Yukari.masterspark(LED5, 0);
-    Yukari.masterspark(LED4, 3);
-    Yukari.masterspark(LED3, 6);
-    Yukari.masterspark(LED14, 9);
-    Yukari.masterspark(LED13, 12);
-    Yukari.masterspark(LED12, 15);
-  }else if(ribbon_R_flag){
-    Yukari.masterspark(LED5, 15);
-    Yukari.masterspark(LED4, 12);
-    Yukari.masterspark(LED3, 9);
-    Yukari.masterspark(LED14, 6);
-    Yukari.masterspark(LED13, 3);
-    Yukari.masterspark(LED12, 0);
   }else{
-    Yukari.marisa_twinkle( LED5,  0);
-    Yukari.marisa_twinkle( LED4, 20);
-    Yukari.marisa_twinkle( LED3, 10);
-    Yukari.marisa_twinkle( LED14, 30);
-    Yukari.marisa_twinkle(LED13, 40);
-    Yukari.marisa_twinkle(LED12, 50);
+    // 片方だけなら触ったリボンの側から流れる　位相は基板の並びから(0-15)
+    uint8_t sweep = spark_L_flag ? SWEEP_LEFT : SWEEP_RIGHT;
+    for(uint8_t i=0;i<6;i++){
+      Yukari.masterspark(SUKIMA_EYES[i], Yukari.phase(SUKIMA_EYES[i], sweep) >> 4);
+    }
   }
+
+  Yukari.layer(LAYER_BASE);
 }
@@ -0,0 +1,21 @@
+/*!
+ * ADCTouch.h - ホスト用のADCTouch互換クラス
+ * 何も触っていない値を返す　タッチはイベントとして外から与える
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#ifndef MoePCB_host_ADCTouch_h
+#define MoePCB_host_ADCTouch_h
+
+#include "Arduino.h"
+
+class ADCTouchClass {
+ public:
+  int read(uint8_t, uint16_t = 100) { return 0; }
+};
+
+static ADCTouchClass ADCTouch;
+
+#endif
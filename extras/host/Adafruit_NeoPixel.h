@@ -0,0 +1,50 @@
+/*!
+ * Adafruit_NeoPixel.h - ホスト用の最小限のNeoPixel互換クラス
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#ifndef MoePCB_host_Adafruit_NeoPixel_h
+#define MoePCB_host_Adafruit_NeoPixel_h
+
+#include "Arduino.h"
+
+#define NEO_GRB ((1 << 6) | (1 << 4) | (0 << 2) | (2))
+#define NEO_KHZ800 0x0000
+
+class Adafruit_NeoPixel {
+ public:
+  Adafruit_NeoPixel(uint16_t n, int16_t pin = 6, uint16_t type = NEO_GRB);
+  Adafruit_NeoPixel(void);
+  Adafruit_NeoPixel(const Adafruit_NeoPixel &);
+  Adafruit_NeoPixel &operator=(const Adafruit_NeoPixel &);
+  ~Adafruit_NeoPixel();
+
+  void begin(void) {}
+  void show(void);
+  void clear(void);
+  void setPixelColor(uint16_t n, uint8_t r, uint8_t g, uint8_t b);
+  void setPixelColor(uint16_t n, uint32_t c);
+  uint32_t getPixelColor(uint16_t n) const;
+  uint8_t *getPixels(void) const { return pixels; }
+  uint16_t numPixels(void) const { return numLEDs; }
+  static uint32_t Color(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+  }
+  static uint32_t ColorHSV(uint16_t hue, uint8_t sat = 255,
+                           uint8_t val = 255);
+
+  // show()が呼ばれた回数（ホスト側の確認用）
+  uint32_t show_count;
+
+ protected:
+  uint16_t numLEDs;
+  uint8_t *pixels;
+};
+
+// 最後にshow()されたフレーム（GRB順）　ホスト側の確認用
+extern const uint8_t *host_frame;
+extern uint16_t host_frame_len;  // バイト数
+
+#endif
@@ -0,0 +1,176 @@
+/*!
+ * Arduino.h - ホスト(PC)上でMoePCBをビルドするための最小限のArduino互換層
+ *
+ * タイマーやADCのレジスタはただの変数（疑似レジスタファイル）なので、
+ * 書き込まれた値をそのまま確認できる
+ * テストはextras/testでmakeすると実行できる
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#ifndef MoePCB_host_Arduino_h
+#define MoePCB_host_Arduino_h
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+#define memcpy_P memcpy
+
+#define _BV(b) (1 << (b))
+#define PI 3.1415926535897932384626433832795
+#define TWO_PI 6.283185307179586476925286766559
+#define bit_is_set(r, b) ((r) & _BV(b))
+#define lowByte(w) ((uint8_t)((w) & 0xff))
+#define highByte(w) ((uint8_t)((w) >> 8))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) \
+  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define ISR(vector, ...) extern "C" void vector(void)
+#define cli()
+#define sei()
+
+// タイマー番号（digitalPinToTimer()の戻り値）AVRコアと同じ値
+#define NOT_ON_TIMER 0
+#define TIMER0A 1
+#define TIMER0B 2
+#define TIMER1A 3
+#define TIMER1B 4
+#define TIMER1C 5
+#define TIMER3A 9
+#define TIMER3B 10
+#define TIMER3C 11
+#define TIMER4A 12
+#define TIMER4B 13
+#define TIMER4C 14
+#define TIMER4D 15
+
+// 疑似レジスタファイル
+// ATmega32U4のレジスタをただの変数として置き換える
+extern volatile uint8_t SREG;
+extern volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+extern volatile uint16_t OCR1A, TCNT1;
+extern volatile uint8_t TCCR3A, TCCR3B, TCCR3C, TIMSK3, TIFR3;
+extern volatile uint16_t OCR3A, TCNT3;
+extern volatile uint8_t TCCR4A, TCCR4B, TCCR4C, TCCR4D, TCCR4E, TIMSK4, TIFR4;
+extern volatile uint8_t OCR4A, OCR4C, TCNT4, TC4H;
+extern volatile uint8_t ADCSRA, ADCSRB, ADMUX;
+extern volatile uint16_t ADCW;
+
+// ビット位置
+#define WGM12 3
+#define WGM32 3
+#define CS10 0
+#define CS30 0
+#define OCIE1A 1
+#define OCIE3A 1
+#define OCIE4A 6
+#define OCF1A 1
+#define OCF3A 1
+#define OCF4A 6
+#define ADEN 7
+#define ADSC 6
+#define MUX5 5
+#define REFS1 7
+#define REFS0 6
+#define MUX2 2
+#define MUX1 1
+#define MUX0 0
+
+// Arduino Leonardoのアナログピン
+#define A0 18
+#define A1 19
+#define A2 20
+#define A3 21
+#define A4 22
+#define A5 23
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+void analogWrite(uint8_t pin, int val);
+uint8_t digitalPinToTimer(uint8_t pin);
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+// ホスト側で時間を進めるための関数
+void host_advance_us(unsigned long us);
+// 最後にanalogWrite()した値と回数（ピンごと）　ホスト側の確認用
+extern int host_analog[32];
+extern unsigned long host_analog_writes[32];
+
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t) = 0;
+  size_t write(const uint8_t *buf, size_t len) {
+    size_t n = 0;
+    while (len--) n += write(*buf++);
+    return n;
+  }
+  size_t print(const char *str) {
+    return write((const uint8_t *)str, strlen(str));
+  }
+  size_t print(long n) {
+    char buf[12];
+    snprintf(buf, sizeof(buf), "%ld", n);
+    return print(buf);
+  }
+  size_t print(int n) { return print((long)n); }
+  size_t print(unsigned int n) { return print((long)n); }
+  size_t print(double n, int digits = 2) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return print(buf);
+  }
+  template <typename T>
+  size_t println(T v) {
+    return print(v) + print("\r\n");
+  }
+  size_t println(void) { return print("\r\n"); }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available(void) { return 0; }
+  virtual int read(void) { return -1; }
+};
+
+// USBシリアル　書き込んだ内容は標準エラー出力に出る
+class Serial_ : public Stream {
+ public:
+  void begin(unsigned long) {}
+  operator bool() { return true; }
+  size_t write(uint8_t c) {
+    fputc(c, stderr);
+    return 1;
+  }
+  using Print::write;
+};
+extern Serial_ Serial;
+
+#endif
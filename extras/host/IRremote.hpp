@@ -0,0 +1,40 @@
+/*!
+ * IRremote.hpp - ホスト用のIRremote互換クラス
+ * 何も受信せず、送信も捨てる　IRはイベントとして外から与える
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#ifndef MoePCB_host_IRremote_hpp
+#define MoePCB_host_IRremote_hpp
+
+#include "Arduino.h"
+
+#define NEC 8
+
+struct IRData {
+  uint8_t protocol;
+  uint16_t address;
+  uint16_t command;
+};
+
+class IRrecv {
+ public:
+  IRData decodedIRData;
+  void begin(uint8_t) {}
+  bool isIdle(void) { return true; }
+  bool decode(void) { return false; }
+  void resume(void) {}
+};
+
+class IRsend {
+ public:
+  void begin(uint8_t) {}
+  void sendNEC(uint16_t, uint8_t, int_fast8_t) {}
+};
+
+static IRrecv IrReceiver;
+static IRsend IrSender;
+
+#endif
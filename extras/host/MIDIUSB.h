@@ -0,0 +1,33 @@
+/*!
+ * MIDIUSB.h - ホスト用のMIDIUSB互換クラス
+ * 何も受信しない　MIDIはイベントとして外から与える
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#ifndef MoePCB_host_MIDIUSB_h
+#define MoePCB_host_MIDIUSB_h
+
+#include "Arduino.h"
+
+typedef struct {
+  uint8_t header;
+  uint8_t byte1;
+  uint8_t byte2;
+  uint8_t byte3;
+} midiEventPacket_t;
+
+class MIDI_ {
+ public:
+  midiEventPacket_t read(void) {
+    midiEventPacket_t rx = {0, 0, 0, 0};
+    return rx;
+  }
+  void sendMIDI(midiEventPacket_t) {}
+  void flush(void) {}
+};
+
+static MIDI_ MidiUSB;
+
+#endif
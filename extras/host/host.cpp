@@ -0,0 +1,183 @@
+/*!
+ * host.cpp - ホスト用Arduino互換層の実装
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "Adafruit_NeoPixel.h"
+#include "Arduino.h"
+
+// 疑似レジスタファイル
+volatile uint8_t SREG;
+volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1, TIFR1;
+volatile uint16_t OCR1A, TCNT1;
+volatile uint8_t TCCR3A, TCCR3B, TCCR3C, TIMSK3, TIFR3;
+volatile uint16_t OCR3A, TCNT3;
+volatile uint8_t TCCR4A, TCCR4B, TCCR4C, TCCR4D, TCCR4E, TIMSK4, TIFR4;
+volatile uint8_t OCR4A, OCR4C, TCNT4, TC4H;
+volatile uint8_t ADCSRA, ADCSRB, ADMUX;
+volatile uint16_t ADCW = 300;
+
+Serial_ Serial;
+
+static unsigned long host_us;
+
+void host_advance_us(unsigned long us) { host_us += us; }
+
+void pinMode(uint8_t, uint8_t) {}
+void digitalWrite(uint8_t, uint8_t) {}
+int host_analog[32];
+unsigned long host_analog_writes[32];
+
+void analogWrite(uint8_t pin, int val) {
+  if (pin >= 32) return;
+  host_analog[pin] = val;
+  host_analog_writes[pin]++;
+}
+
+// Arduino Leonardo(ATmega32U4)のピン→タイマー対応表
+uint8_t digitalPinToTimer(uint8_t pin) {
+  switch (pin) {
+    case 3:
+      return TIMER0B;
+    case 5:
+      return TIMER3A;
+    case 6:
+      return TIMER4D;
+    case 9:
+      return TIMER1A;
+    case 10:
+      return TIMER1B;
+    case 11:
+      return TIMER0A;
+    case 13:
+      return TIMER4A;
+    default:
+      return NOT_ON_TIMER;
+  }
+}
+
+unsigned long millis(void) { return host_us / 1000; }
+unsigned long micros(void) { return host_us; }
+void delay(unsigned long ms) { host_us += ms * 1000; }
+
+// avr-libcのrandom()と同じ系列を返す（Park-Miller minimal standard）
+static unsigned long host_next = 1;
+
+static long host_do_random(unsigned long *ctx) {
+  long hi, lo, x;
+  x = *ctx;
+  if (x == 0) x = 123459876L;
+  hi = x / 127773L;
+  lo = x % 127773L;
+  x = 16807L * lo - 2836L * hi;
+  if (x < 0) x += 0x7fffffffL;
+  return ((*ctx = x) % ((unsigned long)0x7fffffffL + 1));
+}
+
+long random(long howbig) {
+  if (howbig == 0) return 0;
+  return host_do_random(&host_next) % howbig;
+}
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+void randomSeed(unsigned long seed) {
+  if (seed != 0) host_next = seed;
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+//------------------------------------------------------------------------------------
+Adafruit_NeoPixel::Adafruit_NeoPixel(uint16_t n, int16_t, uint16_t)
+    : show_count(0), numLEDs(n), pixels((uint8_t *)calloc(n * 3, 1)) {}
+Adafruit_NeoPixel::Adafruit_NeoPixel(void)
+    : show_count(0), numLEDs(0), pixels(NULL) {}
+Adafruit_NeoPixel::Adafruit_NeoPixel(const Adafruit_NeoPixel &o)
+    : show_count(0), numLEDs(0), pixels(NULL) {
+  *this = o;
+}
+Adafruit_NeoPixel &Adafruit_NeoPixel::operator=(const Adafruit_NeoPixel &o) {
+  if (this == &o) return *this;
+  free(pixels);
+  numLEDs = o.numLEDs;
+  pixels = (uint8_t *)calloc(numLEDs * 3 + 1, 1);
+  if (o.pixels) memcpy(pixels, o.pixels, numLEDs * 3);
+  return *this;
+}
+Adafruit_NeoPixel::~Adafruit_NeoPixel() { free(pixels); }
+
+const uint8_t *host_frame = NULL;
+uint16_t host_frame_len = 0;
+
+void Adafruit_NeoPixel::show(void) {
+  show_count++;
+  host_frame = pixels;
+  host_frame_len = numLEDs * 3;
+}
+void Adafruit_NeoPixel::clear(void) { memset(pixels, 0, numLEDs * 3); }
+
+// NEO_GRB固定
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint8_t r, uint8_t g,
+                                      uint8_t b) {
+  if (n >= numLEDs) return;
+  uint8_t *p = &pixels[n * 3];
+  p[0] = g;
+  p[1] = r;
+  p[2] = b;
+}
+void Adafruit_NeoPixel::setPixelColor(uint16_t n, uint32_t c) {
+  setPixelColor(n, (uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c);
+}
+uint32_t Adafruit_NeoPixel::getPixelColor(uint16_t n) const {
+  if (n >= numLEDs) return 0;
+  const uint8_t *p = &pixels[n * 3];
+  return ((uint32_t)p[1] << 16) | ((uint32_t)p[0] << 8) | p[2];
+}
+
+// Adafruit_NeoPixel::ColorHSV()と同じ計算
+uint32_t Adafruit_NeoPixel::ColorHSV(uint16_t hue, uint8_t sat, uint8_t val) {
+  uint8_t r, g, b;
+  hue = (hue * 1530L + 32768) / 65536;
+  if (hue < 510) {
+    b = 0;
+    if (hue < 255) {
+      r = 255;
+      g = hue;
+    } else {
+      r = 510 - hue;
+      g = 255;
+    }
+  } else if (hue < 1020) {
+    r = 0;
+    if (hue < 765) {
+      g = 255;
+      b = hue - 510;
+    } else {
+      g = 1020 - hue;
+      b = 255;
+    }
+  } else if (hue < 1530) {
+    g = 0;
+    if (hue < 1275) {
+      r = hue - 1020;
+      b = 255;
+    } else {
+      r = 255;
+      b = 1530 - hue;
+    }
+  } else {
+    r = 255;
+    g = b = 0;
+  }
+  uint32_t v1 = 1 + val;
+  uint16_t s1 = 1 + sat;
+  uint8_t s2 = 255 - sat;
+  return ((((((r * s1) >> 8) + s2) * v1) & 0xff00) << 8) |
+         (((((g * s1) >> 8) + s2) * v1) & 0xff00) |
+         (((((b * s1) >> 8) + s2) * v1) >> 8);
+}
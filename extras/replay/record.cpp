@@ -0,0 +1,91 @@
+/*!
+ * record.cpp - golden/の記録と期待フレームを作り直す
+ *
+ * 実機ではなくPC上でYukarinoのsetup()とMoePCB_Task()を回し、
+ * 台本どおりにイベントを投げながらtrace_begin()で記録をとる
+ * show()されたフレームをそのまま期待値として書き出すので、
+ * make checkは「前回作ったときと同じ光り方か」を確かめるためのもの
+ * 点灯パターンを意図して変えたときだけ make golden で作り直す
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include <stdio.h>
+
+#include "MoePCB.h"
+
+extern MoePCB REPLAY_PCB;
+void setup(void);
+
+// Printの書き出し先をファイルにする
+class FilePrint : public Print {
+ public:
+  FilePrint(FILE *f) : _f(f) {}
+  size_t write(uint8_t c) { return (fputc(c, _f) == EOF) ? 0 : 1; }
+  using Print::write;
+
+ private:
+  FILE *_f;
+};
+
+// 台本　フレーム番号、タイミング(0:フレームの前半 1:後半)、イベント
+struct Cue {
+  int frame;
+  uint8_t late;
+  uint8_t type, d0, d1;
+};
+
+// チャンネルはYukarinoのTOUCH_MUNE(0)〜TOUCH_RIBBON_L(3)
+static const Cue cues[] = {
+    {50, 0, EV_TOUCH, 0, 1},   {53, 0, EV_TOUCH, 0, 0},   // 胸
+    {120, 0, EV_TOUCH, 1, 1},  {240, 0, EV_TOUCH, 1, 1},  // スカート　パターン切り替え
+    {150, 1, EV_TOUCH, 2, 1},  {170, 1, EV_TOUCH, 2, 0},  // 右リボン
+    {200, 1, EV_BRIGHTNESS, BRIGHTNESS_NEXT, 0},          // 髪
+    {300, 1, EV_IR, MARISA, 1},                           // 魔理沙を見つけた
+    {400, 1, EV_TOUCH, 3, 1},  {460, 1, EV_TOUCH, 3, 0},  // 左リボン
+};
+
+#define RECORD_FRAMES 600
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: record trace.bin frames.grb\n");
+    return 2;
+  }
+  FILE *trace = fopen(argv[1], "wb");
+  FILE *frames = fopen(argv[2], "wb");
+  if ((trace == NULL) || (frames == NULL)) {
+    fprintf(stderr, "cannot write\n");
+    return 2;
+  }
+
+  setup();
+  REPLAY_PCB.trace_begin(2048);
+  for (int t = 0; t < RECORD_FRAMES; t++) {
+    // loop()の20ms周期がばらつく様子をまねる
+    for (uint8_t late = 0; late < 2; late++) {
+      host_advance_us(late ? 4000 + (t * 31) % 5000 : 9000 + (t * 7919) % 3000);
+      for (size_t i = 0; i < sizeof(cues) / sizeof(cues[0]); i++)
+        if ((cues[i].frame == t) && (cues[i].late == late))
+          REPLAY_PCB.event_post(cues[i].type, cues[i].d0, cues[i].d1, 0);
+    }
+    if (t == 500) REPLAY_PCB.brightness_add();
+    host_advance_us(3000);
+    MoePCB_Task();
+    fwrite(host_frame, 1, host_frame_len, frames);
+  }
+  fclose(frames);
+
+  if (REPLAY_PCB.Get_trace_wrapped()) {
+    fprintf(stderr, "trace ring wrapped\n");
+    fclose(trace);
+    return 1;
+  }
+  FilePrint out(trace);
+  REPLAY_PCB.trace_dump(out);
+  fclose(trace);
+  printf("record: %d frames, %u trace bytes\n", RECORD_FRAMES,
+         REPLAY_PCB.Get_trace_used());
+  return 0;
+}
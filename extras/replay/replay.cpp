@@ -0,0 +1,208 @@
+/*!
+ * replay.cpp - trace_dump()で書き出した入力の記録をPC上で再生する
+ *
+ * スケッチのsetup()を一度呼んだあと、記録したフレームごとに
+ *   そのフレームまでに読み出されたイベントを当時の待ち時間どおりに投げ、
+ *   時刻を進めてMoePCB_Task()を呼び、show()されたGRB値を１フレームとして取り出す
+ * loop()は呼ばないので、イベントを使わずloop()で直接変えている状態
+ * （Basicスケッチの点灯パターン切り替えなど）は再現されない
+ * loop()でrandom()を引くと乱数の系列が実機とずれるので、一致させたいスケッチでは
+ * random()はMoePCB_Task()側だけで使う
+ * リングが一周した記録は途中の状態から始まっていて再生できないので、終了コード2で止める
+ *
+ * 使い方（ビルドはMakefileを参照）
+ *   ./replay trace.bin -o frames.grb   再生したフレームを書き出す
+ *   ./replay trace.bin -g golden.grb   書き出しておいたフレームと比べる　違えば終了コード1
+ *   ./replay trace.bin -n 100          100回繰り返して１秒あたりのフレーム数を測る
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include <stdio.h>
+
+#include <chrono>
+#include <vector>
+
+#include "MoePCB.h"
+
+extern MoePCB REPLAY_PCB;
+void setup(void);
+
+static bool read_file(const char *path, std::vector<uint8_t> *out) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) return false;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    out->insert(out->end(), buf, buf + n);
+  fclose(f);
+  return true;
+}
+
+static void usage(void) {
+  fprintf(stderr,
+          "usage: replay [-o frames.grb] [-g golden.grb] [-n repeat] "
+          "trace.bin\n");
+}
+
+int main(int argc, char **argv) {
+  const char *trace_path = NULL;
+  const char *out_path = NULL;
+  const char *golden_path = NULL;
+  long repeat = 1;
+  for (int i = 1; i < argc; i++) {
+    if ((argv[i][0] == '-') && (i + 1 < argc)) {
+      if (argv[i][1] == 'o') out_path = argv[++i];
+      else if (argv[i][1] == 'g') golden_path = argv[++i];
+      else if (argv[i][1] == 'n') repeat = atol(argv[++i]);
+      else {
+        usage();
+        return 2;
+      }
+    } else if (trace_path == NULL) {
+      trace_path = argv[i];
+    } else {
+      usage();
+      return 2;
+    }
+  }
+  if ((trace_path == NULL) || (repeat < 1)) {
+    usage();
+    return 2;
+  }
+
+  std::vector<uint8_t> trace;
+  if (!read_file(trace_path, &trace)) {
+    fprintf(stderr, "%s: cannot read\n", trace_path);
+    return 2;
+  }
+  if ((trace.size() < TRACE_HEADER_SIZE) || (trace[0] != 'M') ||
+      (trace[1] != 'T') || (trace[2] != TRACE_VERSION)) {
+    fprintf(stderr, "%s: not a MoePCB trace (version %d)\n", trace_path,
+            TRACE_VERSION);
+    return 2;
+  }
+  uint8_t flags = trace[3];
+  if (flags & TRACE_FLAG_WRAPPED) {
+    fprintf(stderr,
+            "%s: ring wrapped, cannot replay from the initial state "
+            "(record with a larger trace_begin() size)\n",
+            trace_path);
+    return 2;
+  }
+  uint8_t led_num = trace[4];
+  uint32_t seed = (uint32_t)trace[6] | ((uint32_t)trace[7] << 8) |
+                  ((uint32_t)trace[8] << 16) | ((uint32_t)trace[9] << 24);
+
+  std::vector<uint8_t> golden;
+  if ((golden_path != NULL) && !read_file(golden_path, &golden)) {
+    fprintf(stderr, "%s: cannot read\n", golden_path);
+    return 2;
+  }
+  FILE *out = NULL;
+  if (out_path != NULL) {
+    out = fopen(out_path, "wb");
+    if (out == NULL) {
+      fprintf(stderr, "%s: cannot write\n", out_path);
+      return 2;
+    }
+  }
+
+  setup();
+  randomSeed(seed);  // 記録開始時と同じ乱数の系列から始める
+
+  size_t frame_len = (size_t)led_num * 3;
+  unsigned long frames = 0, events = 0, dropped = 0;
+  unsigned long diff_frames = 0, first_diff = 0;
+  int first_diff_led = 0, max_diff = 0;
+  bool truncated = false;
+
+  auto start = std::chrono::steady_clock::now();
+  for (long pass = 0; pass < repeat; pass++) {
+    size_t pending = 0;  // 次のティックで投げるイベントの先頭位置
+    size_t n_pending = 0;
+    size_t p = TRACE_HEADER_SIZE;
+    while (p < trace.size()) {
+      uint8_t rec = trace[p];
+      if (!(rec & TRACE_TICK)) {
+        if (trace.size() < p + TRACE_EVENT_SIZE) {
+          truncated = true;
+          break;
+        }
+        if (n_pending == 0) pending = p;
+        n_pending++;
+        p += TRACE_EVENT_SIZE;
+        continue;
+      }
+      p++;
+
+      // 読み出された時刻から待ち時間だけ遡った時刻にイベントを投げる
+      unsigned long target = micros() + (unsigned long)(rec & 0x7F) * 1000;
+      for (size_t e = 0; e < n_pending; e++) {
+        const uint8_t *ev = &trace[pending + e * TRACE_EVENT_SIZE];
+        unsigned long at = target - (unsigned long)ev[4] * 128;
+        if ((long)(at - micros()) > 0) host_advance_us(at - micros());
+        if (!REPLAY_PCB.event_post(ev[0], ev[1], ev[2], ev[3])) dropped++;
+      }
+      if (pass == 0) events += n_pending;
+      n_pending = 0;
+      if ((long)(target - micros()) > 0) host_advance_us(target - micros());
+
+      MoePCB_Task();
+      if (pass != 0) continue;
+
+      // １回目の再生だけフレームを書き出し・比較する
+      frames++;
+      if (host_frame_len != frame_len) {
+        fprintf(stderr, "frame %lu: %u bytes shown, expected %u\n", frames - 1,
+                host_frame_len, (unsigned)frame_len);
+        return 2;
+      }
+      if (out != NULL) fwrite(host_frame, 1, frame_len, out);
+      if (golden_path != NULL) {
+        size_t g = (frames - 1) * frame_len;
+        bool differ = golden.size() < g + frame_len;
+        for (size_t b = 0; !differ && (b < frame_len); b++)
+          differ = (host_frame[b] != golden[g + b]);
+        if (differ) {
+          if (diff_frames == 0) first_diff = frames - 1;
+          diff_frames++;
+          for (size_t b = 0; (golden.size() >= g + frame_len) && (b < frame_len);
+               b++) {
+            int d = abs((int)host_frame[b] - (int)golden[g + b]);
+            if ((diff_frames == 1) && d && (first_diff_led == 0))
+              first_diff_led = b / 3 + 1;
+            max_diff = max(max_diff, d);
+          }
+        }
+      }
+    }
+  }
+  double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                             start)
+                   .count();
+  if (out != NULL) fclose(out);
+
+  printf("trace: %u bytes, %lu frames, %lu events, %u LEDs%s\n",
+         (unsigned)(trace.size() - TRACE_HEADER_SIZE), frames, events,
+         led_num, truncated ? ", truncated" : "");
+  if (dropped) printf("  note: %lu events dropped (queue full)\n", dropped);
+  unsigned long total = frames * repeat;
+  if (0 < sec)
+    printf("replay: %lu frames in %.3f s, %.0f frames/s (%.2f us/frame)\n",
+           total, sec, total / sec, sec * 1e6 / max(total, 1UL));
+
+  if (golden_path == NULL) return 0;
+  if (golden.size() != frames * frame_len)
+    printf("golden: %u frames, replay %lu frames\n",
+           (unsigned)(golden.size() / max(frame_len, (size_t)1)), frames);
+  if (diff_frames == 0) {
+    printf("golden: match\n");
+    return (golden.size() == frames * frame_len) ? 0 : 1;
+  }
+  printf("golden: %lu / %lu frames differ, first at frame %lu LED%d, max "
+         "diff %d\n",
+         diff_frames, frames, first_diff, first_diff_led, max_diff);
+  return 1;
+}
@@ -0,0 +1,31 @@
+/*!
+ * check.h - ホスト用テストの最小限の確認マクロ
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#ifndef MoePCB_test_check_h
+#define MoePCB_test_check_h
+
+#include <stdio.h>
+
+static int check_failed = 0;
+
+// 失敗しても止めずに続きを確認する
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+      check_failed++;                                                 \
+    }                                                                 \
+  } while (0)
+
+// main()の最後に　失敗があれば終了コード1
+#define CHECK_DONE()                                               \
+  do {                                                             \
+    printf("%s: %s\n", __FILE__, check_failed ? "FAILED" : "ok"); \
+    return check_failed ? 1 : 0;                                   \
+  } while (0)
+
+#endif
@@ -0,0 +1,115 @@
+/*!
+ * test_aux.cpp - 補助チャンネル（単色PWM LED）のピン確認・追従・怒りゲージ・書き込み回数を確認する
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "MoePCB.h"
+#include "check.h"
+
+void MoePCB_Task(void) {}
+
+// スケッチと同じくグローバルに置く（カウンタ類は0から始まる前提）
+static MoePCB before(1), free_run(1), ticking(1), pcb(1);
+
+static void test_pins(void) {
+  // begin()前　定期実行タイマー（ここではタイマー１）を使うかまだわからない
+  before.timer(MOE_TIMER1, 50);
+  CHECK(!before.aux_begin(AUX1, 9));   // タイマー１のピン
+  CHECK(!before.aux_begin(AUX1, 10));
+  CHECK(!before.aux_begin(AUX1, 2));   // PWMが無い
+  CHECK(!before.aux_begin(AUX1, 7));
+  CHECK(!before.aux_begin(AUX1, LED0));        // 背面LED
+  CHECK(!before.aux_begin(AUX1, RGBLED_PIN));  // RGBLED
+  CHECK(!before.aux_begin(AUX_NUM, 11));       // 範囲外のチャンネル
+  CHECK(before.aux_begin(AUX1, 11));   // タイマー０
+  CHECK(before.aux_begin(AUX2, 5));    // タイマー３
+
+  // begin(false)ならタイマーは動かないのでタイマー１のピンも使える
+  free_run.timer(MOE_TIMER1, 50);
+  free_run.begin(false);
+  CHECK(free_run.aux_begin(AUX1, 9));
+  CHECK(!free_run.aux_begin(AUX2, 2));  // PWMが無いピンは変わらず使えない
+
+  // begin(true)でタイマーが動いたら、そのタイマーのピンは使えない
+  ticking.timer(MOE_TIMER1, 50);
+  ticking.begin(true);
+  CHECK(ticking.Get_timer_conflict() == 0);
+  CHECK(!ticking.aux_begin(AUX1, 9));
+  CHECK(ticking.aux_begin(AUX1, 3));
+}
+
+static void test_follow(void) {
+  const uint8_t pin = 11;
+  pcb.begin();
+  CHECK(pcb.aux_begin(AUX1, pin));
+  CHECK(host_analog[pin] == 0);
+  unsigned long writes = host_analog_writes[pin];
+
+  // 指示値へ少しずつ追従し、出力が変わったフレームだけ書き込む
+  pcb.aux(AUX1, 255);
+  uint8_t last = 0;
+  unsigned long changes = 0;
+  bool rising = true;
+  for (int f = 0; f < 400; f++) {
+    pcb.update();
+    uint8_t out = pcb.Get_aux(AUX1);
+    rising &= (last <= out);
+    if (out != last) changes++;
+    last = out;
+  }
+  CHECK(rising);
+  CHECK(host_analog_writes[pin] - writes == changes);
+  CHECK(host_analog[pin] == last);
+  // 明るさ1（初期値）は半分の出力　差分で追従するので255の手前(254)で止まる
+  CHECK(last == 126);  // aux_curve[254]=252 の半分
+  CHECK(2 < changes);
+
+  // 落ち着いたら書き込まない
+  writes = host_analog_writes[pin];
+  for (int f = 0; f < 50; f++) pcb.update();
+  CHECK(host_analog_writes[pin] == writes);
+
+  // 0へ戻る　16未満は0.5ずつなので最後まで届く
+  pcb.aux(AUX1, 0);
+  for (int f = 0; f < 400; f++) pcb.update();
+  CHECK(pcb.Get_aux(AUX1) == 0);
+  CHECK(host_analog[pin] == 0);
+
+  // aux_flash()は追従値をすぐ上げて、そこから指示値へ戻る
+  pcb.aux_flash(AUX1, 255);
+  pcb.update();
+  CHECK(100 < pcb.Get_aux(AUX1));
+  for (int f = 0; f < 400; f++) pcb.update();
+  CHECK(pcb.Get_aux(AUX1) == 0);
+  CHECK(pcb.Get_aux(AUX_NUM) == 0);  // 範囲外のチャンネル
+}
+
+// 怒りゲージは指示値を無視して最大まで点け、脈動させる
+static void test_fury(void) {
+  pcb.aux(AUX1, 0);
+  pcb.angry(true);
+  uint8_t peak = 0, low = 255;
+  for (int f = 0; f < 200; f++) {
+    pcb.update();
+    if (100 <= f) {  // ゲージが溜まってから
+      peak = max(peak, pcb.Get_aux(AUX1));
+      low = min(low, pcb.Get_aux(AUX1));
+    }
+  }
+  CHECK(peak == 127);
+  CHECK(low < peak);  // 脈動している
+  CHECK(0 < low);
+
+  pcb.angry(false);
+  for (int f = 0; f < 600; f++) pcb.update();
+  CHECK(pcb.Get_aux(AUX1) == 0);
+}
+
+int main(void) {
+  test_pins();
+  test_follow();
+  test_fury();
+  CHECK_DONE();
+}
@@ -0,0 +1,102 @@
+/*!
+ * test_event.cpp - MoeEventQueueの順序・一周・満杯時の数え方と、update()での反映を確認する
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "MoePCB.h"
+#include "check.h"
+
+void MoePCB_Task(void) {}
+
+// 入れた順に出てくる
+static void test_order(void) {
+  MoeEventQueue q;
+  MoeEvent ev;
+  CHECK(!q.pop(&ev));
+  for (uint8_t i = 0; i < 5; i++) CHECK(q.push(EV_TOUCH, i, i + 1, i + 2));
+  CHECK(q.Get_count() == 5);
+  for (uint8_t i = 0; i < 5; i++) {
+    CHECK(q.pop(&ev));
+    CHECK((ev.type == EV_TOUCH) && (ev.d0 == i) && (ev.d1 == i + 1) &&
+          (ev.d2 == i + 2));
+  }
+  CHECK(!q.pop(&ev));
+  CHECK(q.Get_count() == 0);
+}
+
+// 添字(1バイト)とリング(EVENT_QUEUE_SIZE)が何周しても順序が崩れない
+static void test_wrap(void) {
+  MoeEventQueue q;
+  MoeEvent ev;
+  uint16_t in = 0, out = 0;
+  bool ok = true;
+  for (uint16_t round = 0; round < 100; round++) {
+    // 毎回ずらした数だけ入れて出す
+    for (uint8_t i = 0; i < (round % EVENT_QUEUE_SIZE) + 1; i++) {
+      q.push(EV_MIDI, in & 0xFF, in >> 8, 0);
+      in++;
+    }
+    while (q.pop(&ev)) {
+      ok = ok && (ev.d0 == (out & 0xFF)) && (ev.d1 == (out >> 8));
+      out++;
+    }
+  }
+  CHECK(ok);
+  CHECK(in == out);
+  CHECK(300 < in);  // 1バイトの添字が一周している
+  CHECK(q.Get_overflow() == 0);
+}
+
+// 満杯なら捨てて数える　取り出せば空きができる
+static void test_overflow(void) {
+  MoeEventQueue q;
+  MoeEvent ev;
+  for (uint8_t i = 0; i < EVENT_QUEUE_SIZE; i++) CHECK(q.push(EV_IR, i, 0, 0));
+  CHECK(q.Get_count() == EVENT_QUEUE_SIZE);
+  CHECK(!q.push(EV_IR, 99, 0, 0));
+  CHECK(!q.push(EV_IR, 99, 0, 0));
+  CHECK(q.Get_overflow() == 2);
+  CHECK(q.pop(&ev));
+  CHECK(ev.d0 == 0);
+  CHECK(q.push(EV_IR, 16, 0, 0));
+  CHECK(q.Get_overflow() == 2);
+  // 捨てたイベントは出てこない
+  for (uint8_t i = 1; i <= EVENT_QUEUE_SIZE; i++) {
+    CHECK(q.pop(&ev));
+    CHECK(ev.d0 == i);
+  }
+  CHECK(!q.pop(&ev));
+}
+
+// update()は読み残しを反映し、ライブラリが扱わない種類だけ数える
+static void test_update(void) {
+  MoePCB pcb(7);
+  pcb.begin();
+  CHECK(pcb.Get_brightness() == 1);
+  pcb.event_post(EV_BRIGHTNESS, BRIGHTNESS_NEXT, 0, 0);
+  pcb.event_post(EV_TOUCH, 0, 1, 0);
+  pcb.event_post(EV_MOOD, MOOD_ANGRY, 1, 0);
+  pcb.event_post(EV_IR, 7, 3, 0);
+  host_advance_us(20000);
+  pcb.update();
+  CHECK(pcb.Get_brightness() == 2);
+  CHECK(pcb.Get_event_unread() == 2);
+  CHECK(0 < pcb.Get_FuryGauge());
+
+  pcb.event_post(EV_BRIGHTNESS, 0, 0, 0);
+  MoeEvent ev;
+  CHECK(pcb.event_read(&ev));  // 読み出した時点で反映される
+  CHECK(pcb.Get_brightness() == 0);
+  pcb.update();
+  CHECK(pcb.Get_event_unread() == 2);
+}
+
+int main(void) {
+  test_order();
+  test_wrap();
+  test_overflow();
+  test_update();
+  CHECK_DONE();
+}
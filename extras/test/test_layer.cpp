@@ -0,0 +1,122 @@
+/*!
+ * test_layer.cpp - 合成レイヤーの色の合成・不透明度のフェード・書き込んだLEDだけの合成を確認する
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include <string.h>
+
+#include "MoePCB.h"
+#include "check.h"
+
+void MoePCB_Task(void) {}
+
+// スケッチと同じくグローバルに置く（カウンタ類は0から始まる前提）
+static MoePCB pcb(4);
+static MoePCB over(4), plain(4);
+
+static void test_blend(void) {
+  const uint32_t under = 0xC08040;
+  const uint32_t over = 0x6090F0;
+  // 不透明度0なら下の色のまま
+  CHECK(MoePCB::blend_color(under, over, 0, BLEND_NORMAL) == under);
+  CHECK(MoePCB::blend_color(under, over, 0, BLEND_ADD) == under);
+  CHECK(MoePCB::blend_color(under, over, 0, BLEND_MAX) == under);
+  // 255なら上の色で完全に上書き
+  CHECK(MoePCB::blend_color(under, over, 255, BLEND_NORMAL) == over);
+  // 加算は255で頭打ち、MAXはチャンネルごとに明るい方
+  CHECK(MoePCB::blend_color(under, over, 255, BLEND_ADD) == 0xFFFFFF);
+  CHECK(MoePCB::blend_color(0x108020, 0x207010, 255, BLEND_ADD) == 0x30F030);
+  CHECK(MoePCB::blend_color(0xFFFFFF, 0xFFFFFF, 255, BLEND_ADD) == 0xFFFFFF);
+  CHECK(MoePCB::blend_color(under, over, 255, BLEND_MAX) == 0xC090F0);
+  // 半分なら中間あたり
+  uint32_t half = MoePCB::blend_color(0x000000, 0xFFFFFF, 128, BLEND_NORMAL);
+  CHECK((half & 0xFF) == 128);
+  CHECK(half == 0x808080);
+}
+
+// 目標値に届くまでのフレーム数を数える
+static int fade_ticks(uint8_t from, uint8_t to, uint16_t ticks) {
+  pcb.layer_fade(LAYER_OVER1, from, 0);
+  pcb.layer_fade(LAYER_OVER1, to, ticks);
+  uint8_t last = from;
+  for (int n = 1; n <= ticks + 10; n++) {
+    pcb.update();
+    uint8_t a = pcb.Get_layer_alpha(LAYER_OVER1);
+    // 途中で行き過ぎたり戻ったりしない
+    if ((from < to) ? (a < last) || (to < a) : (last < a) || (a < to)) return -1;
+    last = a;
+    if (a == to) return n;
+  }
+  return 0;
+}
+
+static void test_fade(void) {
+  pcb.begin();
+  CHECK(pcb.layer_begin(LAYER_OVER1, BLEND_NORMAL));
+  CHECK(pcb.Get_layer_alpha(LAYER_OVER1) == 0);  // 最初は透明
+
+  CHECK(fade_ticks(0, 255, 25) == 25);
+  CHECK(fade_ticks(255, 0, 25) == 25);
+  CHECK(fade_ticks(0, 255, 7) == 7);
+  CHECK(fade_ticks(30, 200, 100) == 100);
+  // 1フレームの変化量が最小単位(1/256)より小さくても、ちょうどそのフレーム数で届く
+  CHECK(fade_ticks(0, 1, 300) == 300);
+  // 0・1フレームはすぐ反映
+  pcb.layer_fade(LAYER_OVER1, 90, 0);
+  CHECK(pcb.Get_layer_alpha(LAYER_OVER1) == 90);
+  pcb.layer_fade(LAYER_OVER1, 10, 1);
+  CHECK(pcb.Get_layer_alpha(LAYER_OVER1) == 10);
+
+  // 同じ目標へのフェード中に呼び直しても延びない
+  pcb.layer_fade(LAYER_OVER1, 200, 20);
+  for (int n = 0; n < 10; n++) {
+    pcb.update();
+    pcb.layer_fade(LAYER_OVER1, 200, 20);
+  }
+  for (int n = 0; n < 10; n++) pcb.update();
+  CHECK(pcb.Get_layer_alpha(LAYER_OVER1) == 200);
+
+  // 範囲外のレイヤーは0
+  CHECK(pcb.Get_layer_alpha(LAYER_NUM) == 0);
+  CHECK(pcb.Get_layer_cost(LAYER_NUM) == 0);
+}
+
+// オーバーレイが書き込まなかったLEDは、オーバーレイが無いときと同じ色になる
+static void test_mask(void) {
+  over.begin();
+  plain.begin();
+  CHECK(over.layer_begin(LAYER_OVER1, BLEND_NORMAL));
+  over.layer_fade(LAYER_OVER1, 255, 0);
+
+  uint8_t a[12], b[12];
+  bool same = true, covered = true;
+  for (int n = 0; n < 100; n++) {
+    for (int i = LED1; i <= LED4; i++) over.moonbreath(i);
+    over.layer(LAYER_OVER1);
+    over.mute(LED3);  // LED3だけ黒で上書き
+    over.update();
+    memcpy(a, host_frame, sizeof(a));
+
+    for (int i = LED1; i <= LED4; i++) plain.moonbreath(i);
+    plain.update();
+    memcpy(b, host_frame, sizeof(b));
+
+    same &= (memcmp(a, b, LED3 * 3) == 0) &&
+            (memcmp(&a[LED4 * 3], &b[LED4 * 3], 3) == 0);
+    covered &= (a[LED3 * 3] == 0) && (a[LED3 * 3 + 1] == 0) &&
+               (a[LED3 * 3 + 2] == 0);
+    host_advance_us(20000);
+  }
+  CHECK(same);
+  CHECK(covered);
+  CHECK(b[LED3 * 3] || b[LED3 * 3 + 1] || b[LED3 * 3 + 2]);  // 下は光っていた
+}
+
+int main(void) {
+  test_blend();
+  test_fade();
+  test_mask();
+  CHECK_DONE();
+}
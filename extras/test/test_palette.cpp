@@ -0,0 +1,75 @@
+/*!
+ * test_palette.cpp - パレットの色が以前のmap()の計算と合っているか全256位置で確認する
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "MoePalette.h"
+#include "check.h"
+
+void MoePCB_Task(void) {}
+
+#define HUE_TOLERANCE 2  // 色環の許容差(度)
+#define SAT_TOLERANCE 2  // 彩度の許容差
+
+// パレット化する前のautumn()　127より後ろは範囲外に外挿していた
+static long old_autumn_h(uint8_t tmp) {
+  if (127 < tmp) return map(tmp, 0, 127, 240, 120);
+  return map(tmp, 127, 255, 120, 240);
+}
+
+// パレット化する前のsword()
+static long old_sword_h(uint8_t tmp, bool sky) {
+  if (sky) return (tmp < 127) ? map(tmp, 0, 127, 140, 255) : map(tmp, 127, 255, 255, 140);
+  return (tmp < 127) ? map(tmp, 0, 127, 8, 56) : map(tmp, 127, 255, 56, 8);
+}
+static long old_sword_s(uint8_t tmp) {
+  if (tmp < 150) return map(tmp, 0, 200, 255, 200);
+  return map(tmp, 200, 255, 200, 255);
+}
+
+// パレット化する前のlvmeter()
+static long old_lvmeter_h(uint8_t pos) { return map(pos, 0, 255, 180, -10); }
+
+static int worst_h[4], worst_s;
+
+static void compare_h(int k, long expect, int16_t got, int t) {
+  int d = labs(expect - got);
+  if (worst_h[k] < d) worst_h[k] = d;
+  if (HUE_TOLERANCE < d)
+    printf("  palette %d pos %d: hue %d, map() %ld\n", k, t, got, expect);
+  CHECK(d <= HUE_TOLERANCE);
+}
+
+int main(void) {
+  for (int t = 0; t < 256; t++) {
+    compare_h(0, old_autumn_h(t), MoePalette::sample(PALETTE_AUTUMN, t, PALETTE_WRAP).h, t);
+    compare_h(1, old_sword_h(t, false), MoePalette::sample(PALETTE_FLAME, t, PALETTE_WRAP).h, t);
+    compare_h(2, old_sword_h(t, true), MoePalette::sample(PALETTE_SKY, t, PALETTE_WRAP).h, t);
+    compare_h(3, old_lvmeter_h(t), MoePalette::sample(PALETTE_LVMETER, t, PALETTE_CLAMP).h, t);
+
+    // 彩度は以前tmp=150で214→150へ段差があり、パレットでは144-160でなだらかにつないでいる
+    if ((t < 144) || (160 < t)) {
+      long s = old_sword_s(t);
+      int d1 = labs(s - MoePalette::sample(PALETTE_FLAME, t, PALETTE_WRAP).s);
+      int d2 = labs(s - MoePalette::sample(PALETTE_SKY, t, PALETTE_WRAP).s);
+      if (worst_s < max(d1, d2)) worst_s = max(d1, d2);
+      CHECK(d1 <= SAT_TOLERANCE);
+      CHECK(d2 <= SAT_TOLERANCE);
+    }
+
+    // swordのサブモードBの減光　(tmp*k)>>8 とmap(tmp,0,255,0,k)の差は1以内
+    const uint8_t dim[4] = {9, 18, 60, 130};
+    for (int b = 0; b < 4; b++)
+      CHECK(labs(map(t, 0, 255, 0, dim[b]) - (((uint16_t)t * dim[b]) >> 8)) <= 1);
+  }
+
+  // 両端はちょうど最初と最後の色
+  CHECK(MoePalette::sample(PALETTE_LVMETER, 0, PALETTE_CLAMP).h == 180);
+  CHECK(MoePalette::sample(PALETTE_LVMETER, 255, PALETTE_CLAMP).h == -10);
+
+  printf("  worst hue diff autumn=%d flame=%d sky=%d lvmeter=%d, sat=%d\n",
+         worst_h[0], worst_h[1], worst_h[2], worst_h[3], worst_s);
+  CHECK_DONE();
+}
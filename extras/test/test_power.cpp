@@ -0,0 +1,96 @@
+/*!
+ * test_power.cpp - 消費電流の制限（power_limit()）の倍率と戻り方を確認する
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include <string.h>
+
+#include "MoePCB.h"
+#include "check.h"
+
+void MoePCB_Task(void) {}
+
+#define LEDS 14
+
+// スケッチと同じくグローバルに置く（カウンタ類は0から始まる前提）
+static MoePCB lim(LEDS), ref(LEDS);
+static uint8_t lim_frame[LEDS * 3], ref_frame[LEDS * 3];
+
+// 両方に同じパターンを描いて１フレーム進める　Cは乱数を使わないので両方同じ色になる
+static void frame(void) {
+  for (int i = 0; i < LEDS; i++) lim.rainbow(i, i * 25, C);
+  lim.update();
+  memcpy(lim_frame, host_frame, sizeof(lim_frame));
+  for (int i = 0; i < LEDS; i++) ref.rainbow(i, i * 25, C);
+  ref.update();
+  memcpy(ref_frame, host_frame, sizeof(ref_frame));
+  host_advance_us(20000);
+}
+
+int main(void) {
+  lim.begin();
+  ref.begin();
+  // 一番明るくして、明るさが落ち着くまで回す
+  lim.event_post(EV_BRIGHTNESS, 3, 0, 0);
+  ref.event_post(EV_BRIGHTNESS, 3, 0, 0);
+  for (int f = 0; f < 200; f++) frame();
+
+  // 上限0（デフォルト）なら何も変えない
+  bool same = true;
+  for (int f = 0; f < 50; f++) {
+    frame();
+    same &= (memcmp(lim_frame, ref_frame, sizeof(lim_frame)) == 0);
+    same &= (lim.Get_power_scale() == 256);
+    same &= (lim.Get_current() == lim.Get_current_demand());
+  }
+  CHECK(same);
+  CHECK(lim.Get_power_limited() == 0);
+
+  // 見積もりの半分を上限にすると、そのフレームからすぐ収まる
+  uint16_t demand = lim.Get_current_demand();
+  CHECK(200 < demand);
+  uint16_t budget = demand / 2;
+  lim.power_limit(budget);
+  frame();
+  CHECK(lim.Get_power_scale() < 160);
+  CHECK(lim.Get_current() <= budget);
+  CHECK(lim.Get_power_limited() == 1);
+
+  // 制限中はずっと上限以下で、暗くしたフレームを数える
+  bool under = true, darker = true;
+  for (int f = 0; f < 100; f++) {
+    frame();
+    under &= (lim.Get_current() <= budget);
+    under &= (lim.Get_current_demand() > budget);  // 制限前の見積もりは変わらず超えている
+    for (int b = 0; b < LEDS * 3; b++) darker &= (lim_frame[b] <= ref_frame[b]);
+  }
+  CHECK(under);
+  CHECK(darker);
+  CHECK(lim.Get_power_limited() == 101);
+
+  // 上限を外すと１フレームごとに少しずつ戻り、256で止まる
+  lim.power_limit(0);
+  uint16_t last = lim.Get_power_scale();
+  bool rising = true;
+  int frames = 0;
+  while ((lim.Get_power_scale() < 256) && (frames < 200)) {
+    frame();
+    frames++;
+    uint16_t scale = lim.Get_power_scale();
+    rising &= (last < scale) && (scale <= 256);
+    last = scale;
+  }
+  CHECK(rising);
+  CHECK(lim.Get_power_scale() == 256);
+  CHECK((10 < frames) && (frames < 100));  // すぐには戻さず、1-2秒で戻る
+  // 戻る途中のフレームも数え、戻ったら増えない
+  uint32_t limited = lim.Get_power_limited();
+  CHECK(limited == 101 + (uint32_t)frames - 1);
+  frame();
+  CHECK(lim.Get_power_limited() == limited);
+  CHECK(memcmp(lim_frame, ref_frame, sizeof(lim_frame)) == 0);
+
+  CHECK_DONE();
+}
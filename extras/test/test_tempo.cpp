@@ -0,0 +1,196 @@
+/*!
+ * test_tempo.cpp - MoeTempoのテンポ推定と、beat_lock()でカウンタが拍に合う様子を確認する
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "MoePCB.h"
+#include "MoeTempo.h"
+#include "check.h"
+
+void MoePCB_Task(void) {}
+
+#define CLOCK_US (500000UL / 24)  // 120BPMのクロック間隔
+
+static bool near(uint32_t a, uint32_t b, uint32_t tol) {
+  return (a < b) ? (b - a <= tol) : (a - b <= tol);
+}
+
+// MIDIクロックでの推定とスタートでの拍合わせ
+static void test_clock(void) {
+  MoeTempo t;
+  unsigned long now = 1000;
+  uint32_t beat;
+  uint8_t pos;
+
+  // 120BPMのクロックで拍の長さを推定する
+  for (int i = 0; i < 24 * 8 + 5; i++) {
+    t.midi(0xF8, 0, 0, now);
+    now += CLOCK_US;
+  }
+  CHECK(t.Get_confidence() > 200);
+  CHECK((499000 < t.Get_beat_us()) && (t.Get_beat_us() < 501000));
+
+  // 拍の途中でスタート　次のクロックが0拍目の頭になる
+  now += 123457;
+  t.midi(0xFA, 0, 0, now);
+  now += 3000;
+  t.midi(0xF8, 0, 0, now);
+  t.phase(now, &beat, &pos);
+  CHECK(beat == 0);
+  CHECK(pos == 0);
+
+  // そこから5拍進んでも小節の位置がずれない
+  for (int i = 0; i < 24 * 5; i++) {
+    now += CLOCK_US;
+    t.midi(0xF8, 0, 0, now);
+  }
+  t.phase(now, &beat, &pos);
+  CHECK(beat == 5);
+  CHECK((pos < 3) || (253 < pos));
+}
+
+// 和音（3音を少しずつずらして弾く）をnotes回鳴らす
+static unsigned long chords(MoeTempo *t, unsigned long now, uint32_t ioi,
+                            int notes) {
+  for (int i = 0; i < notes; i++) {
+    t->midi(0x90, 60, 100, now);
+    t->midi(0x90, 64, 100, now + 12000);
+    t->midi(0x90, 67, 90, now + 30000);
+    t->midi(0x90, 67, 0, now + 40000);  // ベロシティ0はノートオフ
+    now += ioi;
+  }
+  return now;
+}
+
+// ノートオンの間隔からの推定
+static void test_onset(void) {
+  MoeTempo t;
+  unsigned long now = 1000;
+
+  // 100BPMの4分音符　和音はひとつにまとめ、初期値の120BPMから測り直す
+  now = chords(&t, now, 600000, 16);
+  CHECK(near(t.Get_beat_us(), 600000, 6000));
+  CHECK(t.Get_confidence() > 200);
+
+  // 8分音符・2分音符・付点なしの4拍でも1拍の長さは変わらない
+  now = chords(&t, now, 300000, 16);
+  CHECK(near(t.Get_beat_us(), 600000, 6000));
+  now = chords(&t, now, 1200000, 8);
+  CHECK(near(t.Get_beat_us(), 600000, 6000));
+  now = chords(&t, now, 2400000, 4);
+  CHECK(near(t.Get_beat_us(), 600000, 6000));
+  CHECK(t.Get_confidence() > 200);
+
+  // 少し速くなったら（105BPM）追従する
+  now = chords(&t, now, 571429, 24);
+  CHECK(near(t.Get_beat_us(), 571429, 6000));
+
+  // 全然違うテンポ（140BPM）が続けば信頼度が落ちてから測り直す
+  uint8_t before = t.Get_confidence();
+  now = chords(&t, now, 428571, 1);
+  now = chords(&t, now, 428571, 1);
+  CHECK(t.Get_confidence() < before);
+  now = chords(&t, now, 428571, 24);
+  CHECK(near(t.Get_beat_us(), 428571, 6000));
+  CHECK(t.Get_confidence() > 200);
+}
+
+// MIDIが途切れたら信頼度が下がっていく
+static void test_decay(void) {
+  MoeTempo t;
+  unsigned long now = 1000;
+  for (int i = 0; i < 24 * 8; i++) {
+    t.midi(0xF8, 0, 0, now);
+    now += CLOCK_US;
+  }
+  uint8_t conf = t.Get_confidence();
+  CHECK(conf > 200);
+
+  // 2拍(1秒)までは下げない
+  unsigned long stop = now;
+  for (; now - stop < 900000; now += 20000) t.tick(now);
+  CHECK(t.Get_confidence() == conf);
+
+  // そこから1秒ほどで0になる　途中で上がることはない
+  bool down = true;
+  uint8_t last = conf;
+  for (; now - stop < 2000000; now += 20000) {
+    t.tick(now);
+    down &= (t.Get_confidence() <= last);
+    last = t.Get_confidence();
+  }
+  CHECK(down);
+  CHECK(t.Get_confidence() == 0);
+
+  // 再開したクロックは途切れていた間を拍の長さや揺れに混ぜず、また拾い直す
+  now += 7777;
+  for (int i = 0; i < 24 * 8; i++) {
+    t.midi(0xF8, 0, 0, now);
+    now += CLOCK_US;
+  }
+  CHECK(t.Get_confidence() > 200);
+  CHECK((499000 < t.Get_beat_us()) && (t.Get_beat_us() < 501000));
+  CHECK(t.Get_jitter_us() < 100);
+}
+
+// beat_lock()で汎用カウンタがN拍で一周する
+// スケッチと同じくグローバルに置く（カウンタ類は0から始まる前提）
+static MoePCB pcb(1);
+
+static void test_lock(void) {
+  pcb.begin();
+  pcb.beat_lock(4);  // 4拍(2秒)で一周
+
+  // 20msごとのフレームの間に120BPMのクロックを投げる　最初にスタート
+  pcb.midi_input(0xFA, 0, 0);
+  unsigned long start = micros() + 7000;  // スタート後の最初のクロックが0拍目の頭
+  unsigned long next_clock = start;
+  uint32_t moved = 0;
+  uint8_t last = pcb.Get_general_cnt();
+  int worst = 0;
+  for (int f = 0; f < 50 * 12; f++) {
+    for (int us = 0; us < 20000; us += 500) {
+      host_advance_us(500);
+      if ((long)(micros() - next_clock) >= 0) {
+        pcb.midi_input(0xF8, 0, 0);
+        next_clock += CLOCK_US;
+      }
+    }
+    pcb.update();
+    uint8_t cnt = pcb.Get_general_cnt();
+    if (50 * 10 <= f) {
+      // 最後の2秒　一周ぶん進み、小節の中の位置（4拍で0-255）にも合っている
+      moved += (uint8_t)(cnt - last);
+      uint8_t expect = ((micros() - start) % 2000000) * 256 / 2000000;
+      worst = max(worst, abs((int8_t)(cnt - expect)));
+    }
+    last = cnt;
+  }
+  CHECK(pcb.Get_tempo_confidence() > 200);
+  CHECK(near(pcb.Get_bpm() * 10, 1200, 5));
+  CHECK(near(moved, 256, 4));
+  CHECK(worst <= 4);
+
+  // MIDIが止まるとフリーラン（1フレームに1ずつ）に戻る
+  for (int f = 0; f < 50 * 3; f++) {
+    host_advance_us(20000);
+    pcb.update();
+  }
+  CHECK(pcb.Get_tempo_confidence() == 0);
+  last = pcb.Get_general_cnt();
+  for (int f = 0; f < 50; f++) {
+    host_advance_us(20000);
+    pcb.update();
+  }
+  CHECK((uint8_t)(pcb.Get_general_cnt() - last) == 50);
+}
+
+int main(void) {
+  test_clock();
+  test_onset();
+  test_decay();
+  test_lock();
+  CHECK_DONE();
+}
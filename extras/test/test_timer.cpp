@@ -0,0 +1,133 @@
+/*!
+ * test_timer.cpp - MoeTimerの周期計算・競合検出を疑似レジスタで確認する
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "MoeTimer.h"
+#include "check.h"
+
+void MoePCB_Task(void) {}
+
+// 電源投入時と同じく全部0に戻す
+static void reset_registers(void) {
+  TCCR1A = TCCR1B = TCCR1C = TIMSK1 = TIFR1 = 0;
+  OCR1A = TCNT1 = 0;
+  TCCR3A = TCCR3B = TCCR3C = TIMSK3 = TIFR3 = 0;
+  OCR3A = TCNT3 = 0;
+  TCCR4A = TCCR4B = TCCR4C = TCCR4D = TCCR4E = TIMSK4 = TIFR4 = 0;
+  OCR4A = OCR4C = TCNT4 = TC4H = 0;
+}
+
+static void test_calc(void) {
+  uint8_t cs;
+  uint16_t top;
+  // タイマー４ 50Hz：1/2048 → OCR4C=155
+  CHECK(MoeTimer::calc(MOE_TIMER4, 50, &cs, &top));
+  CHECK(cs == 12);
+  CHECK(top == 155);
+  // タイマー１・３ 50Hz：1/8 → OCR1A=39999
+  CHECK(MoeTimer::calc(MOE_TIMER1, 50, &cs, &top));
+  CHECK(cs == 2);
+  CHECK(top == 39999);
+  CHECK(MoeTimer::calc(MOE_TIMER3, 50, &cs, &top));
+  CHECK(cs == 2);
+  CHECK(top == 39999);
+  // 作れない周期・タイマー
+  CHECK(!MoeTimer::calc(MOE_TIMER4, 0, &cs, &top));
+  CHECK(!MoeTimer::calc(0, 50, &cs, &top));
+}
+
+static void test_begin(void) {
+  reset_registers();
+  MoeTimer t4;
+  CHECK(t4.begin());
+  CHECK(t4.Get_conflict() == 0);
+  CHECK(TCCR4B == 12);
+  CHECK(OCR4C == 155);
+  CHECK(TIMSK4 & (1 << OCIE4A));
+  CHECK(t4.check());
+
+  t4.pause();
+  CHECK(!(TIMSK4 & (1 << OCIE4A)));
+  t4.resume();
+  CHECK(TIMSK4 & (1 << OCIE4A));
+
+  reset_registers();
+  MoeTimer t1;
+  t1.select(MOE_TIMER1, 50);
+  CHECK(t1.begin());
+  CHECK(TCCR1B == ((1 << WGM12) | 2));
+  CHECK(OCR1A == 39999);
+  CHECK(TIMSK1 & (1 << OCIE1A));
+  CHECK(t1.check());
+}
+
+static void test_conflict(void) {
+  // 他のライブラリが先に割り込みを有効にしている
+  reset_registers();
+  TIMSK4 = 1;
+  MoeTimer busy;
+  CHECK(!busy.begin());
+  CHECK(busy.Get_conflict() == MOE_TIMER_BIT(MOE_TIMER4));
+  CHECK(TCCR4B == 0);  // 何も書き込まない
+
+  // 宣言されたタイマー
+  reset_registers();
+  MoeTimer claimed;
+  claimed.claim(MOE_TIMER4);
+  CHECK(!claimed.begin());
+  CHECK(claimed.Get_conflict() == MOE_TIMER_BIT(MOE_TIMER4));
+
+  // analogWrite()するピン　D13はタイマー４、D9はタイマー１
+  reset_registers();
+  MoeTimer pin;
+  pin.claim_pin(9);
+  CHECK(pin.begin());
+  pin.stop();
+  pin.claim_pin(13);
+  CHECK(!pin.begin());
+
+  // 別のタイマーを宣言しても影響しない
+  reset_registers();
+  MoeTimer other;
+  other.claim(MOE_TIMER3);
+  CHECK(other.begin());
+}
+
+static void test_check(void) {
+  // 開始後に他のライブラリがレジスタを書き換えた
+  reset_registers();
+  MoeTimer t4;
+  CHECK(t4.begin());
+  OCR4C = 10;
+  CHECK(!t4.check());
+  CHECK(t4.Get_conflict() == MOE_TIMER_BIT(MOE_TIMER4));
+
+  reset_registers();
+  MoeTimer t1;
+  t1.select(MOE_TIMER1, 50);
+  CHECK(t1.begin());
+  TCCR1B = 1;  // プリスケーラを変えられた
+  CHECK(!t1.check());
+
+  reset_registers();
+  MoeTimer t3;
+  t3.select(MOE_TIMER3, 50);
+  CHECK(t3.begin());
+  TIMSK3 = 0;  // 割り込みを止められた
+  CHECK(!t3.check());
+
+  // 開始していなければ確認しない
+  MoeTimer idle;
+  CHECK(idle.check());
+}
+
+int main(void) {
+  test_calc();
+  test_begin();
+  test_conflict();
+  test_check();
+  CHECK_DONE();
+}
@@ -0,0 +1,148 @@
+/*!
+ * MoeBoard.cpp - 基板ごとのLEDの並びと、そこから作る位相マップ
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "MoeBoard.h"
+
+#include "Arduino.h"
+#include "MoePCB.h"
+
+// どの基板も実測ではなく、サンプルスケッチの位相差やポジション指定の順番から起こした概略の並び
+// （ゆかりんも含め、回路図や基板データとはまだ突き合わせていない）
+// 表の順番はLED1,LED2...　回路図に合わせて直すとすべてのパターンに反映される
+
+// 羽の結晶　左から4,3,2,5,6,7  LED1は裏面
+static const MoeLedPos layout_fran[] PROGMEM = {
+    {128, 128}, {102, 128}, {51, 96}, {0, 64},
+    {153, 128}, {204, 96}, {255, 64},
+};
+
+// 羽の氷　左から4,3,2,5,6,7  LED1は裏面
+static const MoeLedPos layout_cirno[] PROGMEM = {
+    {128, 128}, {102, 128}, {51, 96}, {0, 64},
+    {153, 128}, {204, 96}, {255, 64},
+};
+
+// 輪　上から時計回りに5,4,3,2,10,9,8,7,6  LED1は裏面
+static const MoeLedPos layout_hina[] PROGMEM = {
+    {128, 128}, {223, 183}, {236, 109}, {199, 44},
+    {128, 18}, {57, 44}, {20, 109}, {33, 183},
+    {90, 231}, {166, 231},
+};
+
+// 上側　左から2-6、緋想の剣　上から7-16  LED1は裏面
+static const MoeLedPos layout_tenshi[] PROGMEM = {
+    {128, 128}, {32, 48}, {64, 36}, {96, 32},
+    {128, 36}, {160, 48}, {224, 20}, {224, 44},
+    {224, 68}, {224, 92}, {224, 116}, {224, 140},
+    {224, 164}, {224, 188}, {224, 212}, {224, 236},
+};
+
+// 輪　上から時計回りに10,11,12,13,14,2(4),3,5,6,7,8,9、中央に15,16  LED1は裏面
+static const MoeLedPos layout_patchu[] PROGMEM = {
+    {128, 128}, {183, 223}, {128, 238}, {128, 208},
+    {73, 223}, {33, 183}, {18, 128}, {33, 73},
+    {73, 33}, {128, 18}, {183, 33}, {223, 73},
+    {238, 128}, {223, 183}, {112, 128}, {144, 128},
+};
+
+// 8から10へ斜め一列　間隔はmarisa_twinkleのポジションから  LED1は裏面
+static const MoeLedPos layout_marisa[] PROGMEM = {
+    {128, 128}, {139, 139}, {110, 110}, {89, 89},
+    {74, 74}, {67, 67}, {46, 46}, {24, 24},
+    {218, 218}, {232, 232}, {203, 203}, {175, 175},
+    {189, 189}, {153, 153}, {96, 160}, {160, 96},
+};
+
+// 傘　左から6-11、スキマのお目々　左から5,4,3,14,13,12  LED1は裏面
+static const MoeLedPos layout_yukari[] PROGMEM = {
+    {128, 128}, {128, 200}, {106, 150}, {61, 150},
+    {16, 150}, {48, 60}, {80, 44}, {112, 36},
+    {144, 36}, {176, 44}, {208, 60}, {240, 150},
+    {195, 150}, {150, 150},
+};
+
+const MoeLedPos *MoeBoard::layout(uint8_t board, uint8_t *num) {
+  switch (board) {
+    case FRAN:
+      *num = sizeof(layout_fran) / sizeof(MoeLedPos);
+      return layout_fran;
+    case CIRNO:
+      *num = sizeof(layout_cirno) / sizeof(MoeLedPos);
+      return layout_cirno;
+    case HINA:
+      *num = sizeof(layout_hina) / sizeof(MoeLedPos);
+      return layout_hina;
+    case TENSHI:
+      *num = sizeof(layout_tenshi) / sizeof(MoeLedPos);
+      return layout_tenshi;
+    case PATCHU:
+      *num = sizeof(layout_patchu) / sizeof(MoeLedPos);
+      return layout_patchu;
+    case MARISA:
+      *num = sizeof(layout_marisa) / sizeof(MoeLedPos);
+      return layout_marisa;
+    case YUKARI:
+      *num = sizeof(layout_yukari) / sizeof(MoeLedPos);
+      return layout_yukari;
+    default:
+      *num = 0;
+      return NULL;
+  }
+}
+
+// begin()で一度だけ計算する　sqrt・atan2はここでしか使わない
+bool MoeBoard::build(uint8_t board, uint8_t led_num, uint8_t *maps) {
+  uint8_t num;
+  const MoeLedPos *pos = layout(board, &num);
+  if (pos == NULL) return false;
+  if (led_num < num) num = led_num;  // 表より少ないLED数で作ったとき
+
+  // 範囲と中心を求める
+  uint8_t x_min = 255, x_max = 0, y_min = 255, y_max = 0;
+  uint16_t x_sum = 0, y_sum = 0;
+  for (uint8_t i = 0; i < num; i++) {
+    uint8_t x = pgm_read_byte(&pos[i].x);
+    uint8_t y = pgm_read_byte(&pos[i].y);
+    x_min = min(x_min, x);
+    x_max = max(x_max, x);
+    y_min = min(y_min, y);
+    y_max = max(y_max, y);
+    x_sum += x;
+    y_sum += y;
+  }
+  float cx = (float)x_sum / num;
+  float cy = (float)y_sum / num;
+  float r_max = 0;
+  for (uint8_t i = 0; i < num; i++) {
+    float dx = pgm_read_byte(&pos[i].x) - cx;
+    float dy = pgm_read_byte(&pos[i].y) - cy;
+    r_max = max(r_max, (float)sqrt(dx * dx + dy * dy));
+  }
+
+  for (uint8_t i = 0; i < led_num; i++) {
+    if (num <= i) {  // 表に無いLEDは0
+      for (uint8_t m = 0; m < SWEEP_NUM; m++) maps[m * led_num + i] = 0;
+      continue;
+    }
+    uint8_t x = pgm_read_byte(&pos[i].x);
+    uint8_t y = pgm_read_byte(&pos[i].y);
+    float dx = x - cx;
+    float dy = y - cy;
+
+    maps[SWEEP_LINEAR * led_num + i] =
+        (y_max == y_min) ? 0 : (uint16_t)(y - y_min) * 255 / (y_max - y_min);
+    maps[SWEEP_LEFT * led_num + i] =
+        (x_max == x_min) ? 0 : (uint16_t)(x - x_min) * 255 / (x_max - x_min);
+    maps[SWEEP_RADIAL * led_num + i] =
+        (r_max == 0) ? 0 : sqrt(dx * dx + dy * dy) * 255 / r_max;
+    // 真上を0として時計回り　一周で256
+    float a = atan2(dx, -dy);
+    if (a < 0) a += TWO_PI;
+    maps[SWEEP_ANGLE * led_num + i] = (uint16_t)(a * 256 / TWO_PI) & 0xFF;
+  }
+  return true;
+}
@@ -0,0 +1,36 @@
+/*!
+ * MoeBoard.h - 基板ごとのLEDの並びと、そこから作る位相マップ
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#ifndef MoeBoard_h
+#define MoeBoard_h
+
+#include "Arduino.h"
+
+// 位相マップの種類
+#define SWEEP_LINEAR 0  // 上→下
+#define SWEEP_RADIAL 1  // 中心→外側
+#define SWEEP_LEFT 2    // 左→右
+#define SWEEP_ANGLE 3   // 真上から時計回りに一周
+#define SWEEP_RIGHT 4   // 右→左（SWEEP_LEFTを反転して使う）
+#define SWEEP_NUM 4     // 保存するマップの数（SWEEP_RIGHTは保存しない）
+
+// LEDの位置　基板の表を0-255に収めた座標（左上が0,0）
+struct MoeLedPos {
+  uint8_t x;
+  uint8_t y;
+};
+
+class MoeBoard {
+ public:
+  // 基板ID(FRANなど)のLEDの並び　知らない基板ならNULL
+  static const MoeLedPos *layout(uint8_t, uint8_t *);
+  // 並びから位相マップ(0-255)をSWEEP_NUM×LED数ぶん書き込む　基板を知らなければfalse
+  static bool build(uint8_t, uint8_t, uint8_t *);
+};
+
+#endif
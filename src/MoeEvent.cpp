@@ -0,0 +1,46 @@
+/*!
+ * MoeEvent.cpp - loop()からタイマー割り込みへ入力を渡すイベントキュー
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "MoeEvent.h"
+
+#include "Arduino.h"
+
+// 中身を書き終えてから添字を進めるよう、コンパイラに並べ替えさせない
+#define MOE_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+MoeEventQueue::MoeEventQueue(void) {
+  _head = 0;
+  _tail = 0;
+  _overflow = 0;
+}
+
+bool MoeEventQueue::push(uint8_t type, uint8_t d0, uint8_t d1, uint8_t d2) {
+  uint8_t head = _head;
+  if ((uint8_t)(head - _tail) >= EVENT_QUEUE_SIZE) {
+    _overflow++;
+    return false;
+  }
+  MoeEvent *ev = &_buf[head & (EVENT_QUEUE_SIZE - 1)];
+  ev->type = type;
+  ev->d0 = d0;
+  ev->d1 = d1;
+  ev->d2 = d2;
+  ev->time = micros() >> 6;
+  MOE_BARRIER();
+  _head = head + 1;
+  return true;
+}
+
+bool MoeEventQueue::pop(MoeEvent *ev) {
+  uint8_t tail = _tail;
+  if (tail == _head) return false;
+  MOE_BARRIER();
+  *ev = _buf[tail & (EVENT_QUEUE_SIZE - 1)];
+  MOE_BARRIER();
+  _tail = tail + 1;
+  return true;
+}
@@ -0,0 +1,57 @@
+/*!
+ * MoeEvent.h - loop()からタイマー割り込みへ入力を渡すイベントキュー
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#ifndef MoeEvent_h
+#define MoeEvent_h
+
+#include "Arduino.h"
+
+// イベントの種類
+#define EV_NONE 0
+#define EV_TOUCH 1       // タッチ d0:チャンネル d1:1で触った0で離した
+#define EV_IR 2          // IR受信 d0:基板ID d1:コマンド d2:データ
+#define EV_MIDI 3        // MIDI d0:ステータス d1,d2:データ
+#define EV_BRIGHTNESS 4  // 明るさ d0:0-3 BRIGHTNESS_NEXTなら１段階追加
+#define EV_MODE 5        // 点灯パターン d0:パターン番号
+#define EV_MOOD 6        // 気分 d0:MOOD_ANGRYなど d1:1で発動0で収まり
+
+#define BRIGHTNESS_NEXT 0xFF
+
+#define MOOD_ANGRY 0
+#define MOOD_COLD 1
+#define MOOD_HEAT 2
+#define MOOD_DRUNK 3
+
+#define EVENT_QUEUE_SIZE 16  // キューの長さ（2のべき乗）
+
+struct MoeEvent {
+  uint8_t type;   // イベントの種類
+  uint8_t d0;     // データ
+  uint8_t d1;
+  uint8_t d2;
+  uint16_t time;  // 投げた時刻 micros()/64（約4秒で一周）
+};
+
+// 書き込みはloop()側だけ、読み出しはタイマー側だけが行う前提のリングバッファ
+// 添字は１バイトなので割り込みを止めなくても途中の値を読むことはない
+class MoeEventQueue {
+ public:
+  MoeEventQueue(void);
+  bool push(uint8_t, uint8_t, uint8_t, uint8_t);  // 満杯ならfalse
+  bool pop(MoeEvent *);                           // 空ならfalse
+  uint8_t Get_count(void) { return (uint8_t)(_head - _tail); }
+  uint16_t Get_overflow(void) { return _overflow; }  // 満杯で捨てた数
+
+ private:
+  MoeEvent _buf[EVENT_QUEUE_SIZE];
+  volatile uint8_t _head;  // 次に書く位置（loop()側だけが進める）
+  volatile uint8_t _tail;  // 次に読む位置（タイマー側だけが進める）
+  volatile uint16_t _overflow;
+};
+
+#endif
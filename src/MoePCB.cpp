@@ -10,67 +10,137 @@
 #include "Arduino.h"
 
 // タイマー４ 20-25ms割り込み
-extern void MoePCB_Task(void);
-
 // NO_USE_TIMER4が宣言されていなければタイマーで自動実行
+// タイマー１・３の割り込みはMoeTimer.cpp
 ISR(TIMER4_COMPA_vect) { MoePCB_Task(); }
 
-// タイマー１版 20-25ms割り込み　※未使用
-//    ISR (TIMER1_COMPA_vect) {
-//      MoePCB_Task();
-//    }
+// 補助チャンネルの明るさ指示値(0-255)→PWM値　CIE1931の明度から求めた知覚的なカーブ
+static const uint8_t aux_curve[256] PROGMEM = {
+      0,   0,   0,   0,   0,   1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,
+      2,   2,   2,   2,   2,   2,   2,   3,   3,   3,   3,   3,   3,   3,   3,   4,
+      4,   4,   4,   4,   4,   5,   5,   5,   5,   5,   6,   6,   6,   6,   6,   7,
+      7,   7,   7,   8,   8,   8,   8,   9,   9,   9,  10,  10,  10,  10,  11,  11,
+     11,  12,  12,  12,  13,  13,  13,  14,  14,  15,  15,  15,  16,  16,  17,  17,
+     17,  18,  18,  19,  19,  20,  20,  21,  21,  22,  22,  23,  23,  24,  24,  25,
+     25,  26,  26,  27,  28,  28,  29,  29,  30,  31,  31,  32,  32,  33,  34,  34,
+     35,  36,  37,  37,  38,  39,  39,  40,  41,  42,  43,  43,  44,  45,  46,  47,
+     47,  48,  49,  50,  51,  52,  53,  54,  54,  55,  56,  57,  58,  59,  60,  61,
+     62,  63,  64,  65,  66,  67,  68,  70,  71,  72,  73,  74,  75,  76,  77,  79,
+     80,  81,  82,  83,  85,  86,  87,  88,  90,  91,  92,  94,  95,  96,  98,  99,
+    100, 102, 103, 105, 106, 108, 109, 110, 112, 113, 115, 116, 118, 120, 121, 123,
+    124, 126, 128, 129, 131, 132, 134, 136, 138, 139, 141, 143, 145, 146, 148, 150,
+    152, 154, 155, 157, 159, 161, 163, 165, 167, 169, 171, 173, 175, 177, 179, 181,
+    183, 185, 187, 189, 191, 193, 196, 198, 200, 202, 204, 207, 209, 211, 214, 216,
+    218, 220, 223, 225, 228, 230, 232, 235, 237, 240, 242, 245, 247, 250, 252, 255,
+};
+
 // コンストラクタ
 MoePCB::MoePCB(uint8_t led_num) {
-  _led_num = led_num;  // LED数をプライベートに保存
+  _led_num = min(led_num, MAX_LED_NUM);  // LED数をプライベートに保存
   Adafruit_NeoPixel pixels(led_num, RGBLED_PIN,
                            NEO_GRB + NEO_KHZ800);  // NeoPixelライブラリ初期化
   _pixels =
       pixels;  // インスタンスハンドルをプライベートに保存　今後はプライベートな方にアクセス
+
+  // ベースレイヤーだけは最初から確保する
+  for (uint8_t l = 0; l < LAYER_NUM; l++) {
+    _layers[l].buf = NULL;
+    _layers[l].mask = 0;
+    _layers[l].alpha = 255 << 8;  // ベースは不透明
+    _layers[l].alpha_ticks = 0;
+    _layers[l].alpha_target = 255;
+    _layers[l].blend = BLEND_NORMAL;
+    _layers[l].draw_us = 0;
+    _layers[l].cost_us = 0;
+    _layers[l].twinkle_last = 0;
+  }
+  _draw_us = 0;
+  if (!layer_alloc(LAYER_BASE)) _led_num = 0;  // 確保できなければ何も光らせない
+  layer_select(LAYER_BASE);
+
+  for (uint8_t c = 0; c < AUX_NUM; c++) _aux[c].pin = AUX_NO_PIN;
+  _led0 = false;
+  _timer_enable = false;
+  _begun = false;
+  _board = 0;
+  _phase = NULL;
+  _power_limit = 0;
+  _power_scale = 256;
+  _current_mA = 0;
+  _demand_mA = 0;
+  _power_limited = 0;
+
+  _general_frac = 0;
+  _gaming_frac = 0;
+  _beat_lock = 0;
+  _brightness = 1;
+  _event_unread = 0;
+  _last_update_us = 0;
+  _tick_us = 20000;  // 50Hz
 }
 
+// 基板を指定するとbegin()で位相マップを作る
+void MoePCB::board(uint8_t id) { _board = id; }
+
 // 指定されなかった場合はタイマー無効で開始する
 void MoePCB::begin() { begin(false); }
 
 void MoePCB::begin(bool timer_enable) {
   pinMode(LED0, OUTPUT);         // 背面ノーマルLED
-  digitalWrite(LED0, LOW);       // ON
+  _led0 = false;
+  led0(true);                    // ON
   _timer_enable = timer_enable;  // タイマー状況を保存
+  _begun = true;
   _pixels.begin();               // RGBLEDライブラリ初期化
   _pixels.clear();
   _pixels.show();
+  // RGBLEDの領域を確保できなかったらLED0を点けたままにして、タイマーも起動しない
+  if (_layers[LAYER_BASE].buf == NULL) {
+    _timer_enable = false;
+    return;
+  }
+  layer_select(LAYER_BASE);
   for (int i = 0; i < _led_num; i++) {  // 初期化
     V_raw[i] = 0;
     V[i] = 0;
   }
 
+  // 基板の並びから位相マップを作っておく　パターンからは表を引くだけ
+  if ((_board != 0) && (_phase == NULL)) {
+    _phase = (uint8_t *)malloc(SWEEP_NUM * _led_num);
+    if ((_phase != NULL) && !MoeBoard::build(_board, _led_num, _phase)) {
+      free(_phase);
+      _phase = NULL;
+    }
+  }
+
   // タイマー起動-IRsendやBMEと同時にタイマー使うと動かなくなることがある
+  // 他のライブラリと競合していたら起動せず、LED0は点いたままになる（Get_timer_conflict()で確認）
   if (_timer_enable) {
-    // タイマーA：20-25msごとにコンペアAクリア＆割り込みを設定
-    TCCR4B = 0;
-    TCCR4A = 0;
-    TCCR4C = 0;
-    TCCR4D = 0;
-    TCCR4E = 0;
-    TCCR4B = 0b1100;  // 1/2048
-    OCR4C = 156;      // 0-255  <-- 16,000,000 MHz / 2048 / 50Hz
-    // OCR4C =195;//0-255  <-- 16,000,000 MHz / 2048 / 40Hz
-    // タイマー４開始処理
-    TIFR4 = (1 << OCF4A);
-    TCNT4 = 0;
-    TIMSK4 = (1 << OCIE4A);
-    digitalWrite(LED0, HIGH);  // OFF
-  }
-  /*
-  //タイマー1：20-25msごとにコンペアAクリア＆割り込みを設定
-  TCCR1B = 0;  TCCR1A = 0;  TCCR1C = 0;
-  TCCR1B = (1<<WGM12)|(1<<CS02)|(1<<CS00);//0b00000010;// 1/1024
-  OCR1A =312;//16bit  <-- 16,000,000 MHz / 1024 / 50Hz
-  //OCR1A =390;//16bit  <-- 16,000,000 MHz / 1024 / 40Hz
-  //タイマー1開始処理
-  TIFR1 = (1<<OCF1A);
-  TCNT1 = 0;
-  TIMSK1 = (1<<OCIE1A);
-  */
+    _timer_enable = _timer.begin();
+    if (_timer_enable) led0(false);  // OFF
+  }
+}
+
+uint8_t MoePCB::phase(int led_id, uint8_t sweep) {
+  if ((_phase == NULL) || (led_id < 0) || (_led_num <= led_id)) return 0;
+  if (sweep == SWEEP_RIGHT) return 255 - _phase[SWEEP_LEFT * _led_num + led_id];
+  if (SWEEP_NUM <= sweep) return 0;
+  return _phase[sweep * _led_num + led_id];
+}
+
+// 使うタイマーと周期を選ぶ
+void MoePCB::timer(uint8_t timer, uint8_t rate_hz) {
+  _timer.select(timer, rate_hz);
+}
+
+// IRremoteなど他のライブラリが使うタイマーを宣言する
+void MoePCB::timer_claim(uint8_t timer) { _timer.claim(timer); }
+
+// タイマーが書き換えられていたらfalse　タイマーが有効なときだけ確認する
+bool MoePCB::timer_check(void) {
+  if (!_timer_enable) return true;
+  return _timer.check();
 }
 // 現在の温度のCPU読みADC値を返す
 float MoePCB::cputemp_raw(void) {
@@ -123,6 +193,7 @@ void MoePCB::drunk(bool state) {
 //------------------------------------------------------------------------------------
 // 消灯
 void MoePCB::mute(int led_id) {
+  if (!layer_touch(led_id)) return;
   H[led_id] = 0;  // 色環は関係なし
   S[led_id] = 0;  // 彩度ゼロ
   V[led_id] = 0;
@@ -130,6 +201,7 @@ void MoePCB::mute(int led_id) {
 //------------------------------------------------------------------------------------
 // ゆっくり呼吸するような白色点滅
 void MoePCB::breath(int led_id) {
+  if (!layer_touch(led_id)) return;
   H[led_id] = 0;  // 色環は関係なし
   S[led_id] = 0;  // 彩度ゼロ
   // イージングは必要ないので輝度は生データを直接触る/
@@ -141,6 +213,7 @@ void MoePCB::breath(int led_id) {
 //------------------------------------------------------------------------------------
 // ゆっくり月色点滅
 void MoePCB::moonbreath(int led_id) {
+  if (!layer_touch(led_id)) return;
   H[led_id] = 60;   // 少し黄色
   S[led_id] = 200;  // 彩度
   // イージングは必要ないので輝度は生データを直接触る/
@@ -155,6 +228,7 @@ void MoePCB::moonbreath(int led_id) {
 }  //------------------------------------------------------------------------------------
 // ゆっくりシアン色点滅（裏LEDに使うと色透けが強い）
 void MoePCB::cyanbreath(int led_id) {
+  if (!layer_touch(led_id)) return;
   H[led_id] = 160;  // シアン
   S[led_id] = 255;  // 彩度
   // イージングは必要ないので輝度は生データを直接触る/
@@ -170,6 +244,7 @@ void MoePCB::cyanbreath(int led_id) {
 //------------------------------------------------------------------------------------
 // ゲーミングモード
 void MoePCB::gaming(int led_id, int phase_shift) {
+  if (!layer_touch(led_id)) return;
   const uint8_t gaming_brightnessTable[4] = {
       25, 65, 175, 250};  // 明るさレベルに応じた明るさ値
   uint8_t cnt_tmp = gaming_cnt - phase_shift;
@@ -183,7 +258,8 @@ void MoePCB::gaming(int led_id, int phase_shift) {
 const uint8_t midi_twinkleTable[4] = {
     65, 155, 255, 255};  // 明るさレベルに応じたモードDで使う光量
 void MoePCB::rainbow(int led_id, int phase_shift, uint8_t sub_mode) {
-  static int led_id_last;  // 1回前にピカッとしたLEDのIDを保存
+  if (!layer_touch(led_id)) return;
+  int8_t &led_id_last = _layers[_layer].twinkle_last;  // 1回前にピカッとしたLEDのID
   V[led_id] = _brightnessTable[_brightness];  // 基本光量
   if ((sub_mode != C) and (sub_mode != D)) {  // C,Dではここはスキップ
     if (random(0, 250) == 0) {                // ランダムで明るくする
@@ -206,13 +282,13 @@ void MoePCB::rainbow(int led_id, int phase_shift, uint8_t sub_mode) {
 //------------------------------------------------------------------------------------
 // ひんやり光パターン
 void MoePCB::icy(int led_id, uint8_t sub_mode) {
-  static int led_id_last;  // 1回前にピカッとしたLEDのIDを保存
+  if (!layer_touch(led_id)) return;
+  int8_t &led_id_last = _layers[_layer].twinkle_last;  // 1回前にピカッとしたLEDのID
   const uint8_t icy_brightnessTable[4] = {3, 10, 20,
                                           30};  // 明るさレベルに応じた明るさ値
   const uint8_t icy_twinkleTable[4] = {
       40, 65, 165, 255};  // 明るさレベルに応じたランダムで変更するきらきら値
   V[led_id] = icy_brightnessTable[_brightness];  // 基本光量
-  static float V_last[30];
 
   if (S[led_id] > 0) S[led_id] -= 3;  // 設定値より現実の値が高ければ徐々に減算
 
@@ -264,7 +340,8 @@ void MoePCB::icy(int led_id, uint8_t sub_mode) {
 //------------------------------------------------------------------------------------
 // ゆっくり秋色変化　位相差をつけるとお好みの色差で光らせられる
 void MoePCB::autumn(int led_id, int phase_shift) {
-  static int led_id_last;  // 1回前にピカッとしたLEDのIDを保存
+  if (!layer_touch(led_id)) return;
+  int8_t &led_id_last = _layers[_layer].twinkle_last;  // 1回前にピカッとしたLEDのID
   V[led_id] = _brightnessTable[_brightness];  // 基本光量
 
   if (random(0, 250) == 0) {  // ランダムで明るくする
@@ -274,19 +351,27 @@ void MoePCB::autumn(int led_id, int phase_shift) {
     }
     led_id_last = led_id;
   }
-  uint8_t tmp = general_cnt - phase_shift;
-  if (127 < tmp)
-    H[led_id] = map(tmp, 0, 127, 240, 120);
-  else
-    H[led_id] = map(tmp, 127, 255, 120, 240);
-  S[led_id] = 255;  // 彩度MAX
+  MoeColor c = MoePalette::sample(PALETTE_AUTUMN, general_cnt - phase_shift,
+                                  PALETTE_WRAP);
+  H[led_id] = c.h;
+  S[led_id] = c.s;
+}
+//------------------------------------------------------------------------------------
+// パレットの色をゆっくり巡る　位相差をつけるとお好みの色差で光らせられる
+void MoePCB::gradient(int led_id, const MoeColor *palette, int phase_shift) {
+  if (!layer_touch(led_id)) return;
+  V[led_id] = _brightnessTable[_brightness];  // 基本光量
+  MoeColor c =
+      MoePalette::sample(palette, general_cnt - phase_shift, PALETTE_WRAP);
+  H[led_id] = c.h;
+  S[led_id] = c.s;
 }
 //------------------------------------------------------------------------------------
 // 緋想の剣　位相差をつけるとお好みの色差で光らせられる modeによって色が変わる
 void MoePCB::sword(int led_id, int phase_shift, uint8_t sub_mode,
                    uint8_t color_mode) {
+  if (!layer_touch(led_id)) return;
   V[led_id] = _brightnessTable[_brightness];  // 基本光量
-  static uint8_t last_color_mode[30];  // 暫定で30個にしている　最適化すべき
   // 変更があったら色を変える
   if (last_color_mode[led_id] != color_mode) {
     V[led_id] = 0;
@@ -295,48 +380,31 @@ void MoePCB::sword(int led_id, int phase_shift, uint8_t sub_mode,
   last_color_mode[led_id] = color_mode;
   uint8_t tmp = general_cnt - phase_shift;
 
-  if (color_mode == A) {  // 燃えるような色
-    if (tmp < 127) {
-      H[led_id] = map(tmp, 0, 127, 8, 56);
-    } else {
-      H[led_id] = map(tmp, 127, 255, 56, 8);
-    }
-  } else if (color_mode == B) {  // 空色
-    if (tmp < 127) {
-      H[led_id] = map(tmp, 0, 127, 140, 255);
-    } else {
-      H[led_id] = map(tmp, 127, 255, 255, 140);
-    }
-  }
-  // 彩度
-  if (tmp < 150) {
-    S[led_id] = map(tmp, 0, 200, 255, 200);
-  } else {
-    S[led_id] = map(tmp, 200, 255, 200, 255);
-  }
+  // Aは燃えるような色、Bは空色　彩度の変化はどちらも同じ
+  MoeColor c = MoePalette::sample(
+      (color_mode == B) ? PALETTE_SKY : PALETTE_FLAME, tmp, PALETTE_WRAP);
+  if ((color_mode == A) || (color_mode == B)) H[led_id] = c.h;
+  S[led_id] = c.s;
 
   if (sub_mode == B) {
-    // 輝度少し弄る
-    if (_brightness == 0)
-      V_raw[led_id] = V[led_id] - map(tmp, 0, 255, 0, 9);
-    else if (_brightness == 1)
-      V_raw[led_id] = V[led_id] - map(tmp, 0, 255, 0, 18);
-    else if (_brightness == 2)
-      V_raw[led_id] = V[led_id] - map(tmp, 0, 255, 0, 60);
-    else if (_brightness == 3)
-      V_raw[led_id] = V[led_id] - map(tmp, 0, 255, 0, 130);
+    // 輝度少し弄る　明るさレベルに応じた最大の減らし幅
+    const uint8_t sword_dimTable[4] = {9, 18, 60, 130};
+    V_raw[led_id] =
+        V[led_id] - (((uint16_t)tmp * sword_dimTable[_brightness]) >> 8);
   }
 }
 //------------------------------------------------------------------------------------
 // レベルメーター
 void MoePCB::lvmeter(int led_id, int atach_position,
                      uint8_t sub_mode) {  // Aはシンプル、Bはピーク付き
+  if (!layer_touch(led_id)) return;
   V[led_id] = _brightnessTable[_brightness];  // 基本光量
   int V_tmp;
   V_tmp = _brightnessTable[_brightness];
-  H[led_id] =
-      map(atach_position, 0, 255, 180,
-          -10);  // メーターの色を青から赤へ　ここ弄るとメーターの色変わる
+  // メーターの色を青から赤へ　PALETTE_LVMETERを弄るとメーターの色変わる
+  H[led_id] = MoePalette::sample(PALETTE_LVMETER,
+                                 constrain(atach_position, 0, 255),
+                                 PALETTE_CLAMP).h;
   S[led_id] = 255;  // 彩度MAX
 
   // メーターポジション以上では輝度ゼロ（消灯）
@@ -355,13 +423,13 @@ void MoePCB::lvmeter(int led_id, int atach_position,
 //------------------------------------------------------------------------------------
 // お星さまキラキラパターン
 void MoePCB::twinklestar(int led_id, uint8_t sub_mode) {
-  static int led_id_last;  // 1回前にピカッとしたLEDのIDを保存
+  if (!layer_touch(led_id)) return;
+  int8_t &led_id_last = _layers[_layer].twinkle_last;  // 1回前にピカッとしたLEDのID
   const uint8_t star_brightnessTable[4] = {0, 0, 0,
                                            0};  // 明るさレベルに応じた明るさ値
   const uint8_t star_twinkleTable[4] = {
       10, 25, 75, 165};  // 明るさレベルに応じたランダムで変更するきらきら値
   V[led_id] = star_brightnessTable[_brightness];  // 基本光量
-  static float V_last[30];
 
   int randomness;
   if (_brightness == 0) randomness = 200;
@@ -423,13 +491,13 @@ void MoePCB::twinklestar(int led_id, uint8_t sub_mode) {
 //------------------------------------------------------------------------------------
 // 魔理沙用通常キラキラパターン
 void MoePCB::marisa_twinkle(int led_id, uint8_t position) {
+  if (!layer_touch(led_id)) return;
   // 明るさレベルに応じた明るさ値
   const uint8_t star_brightnessTable[4] = {2, 3, 3, 4};
   // 明るさレベルに応じたランダムで変更するきらきら値
   const uint8_t star_twinkleTable[4] = {25, 50, 100, 200};
   //  const uint8_t star_twinkleTable[4] = {10, 25, 75, 165};
   V[led_id] = star_brightnessTable[_brightness];  // 基本光量
-  static float V_last[30];
 
   if (S[led_id] > 0) S[led_id] -= 3;  // 設定値より現実の値が高ければ徐々に減算
 
@@ -468,6 +536,7 @@ void MoePCB::masterspark(int led_id, int phase_shift) {
   masterspark(led_id, phase_shift, false);
 }
 void MoePCB::masterspark(int led_id, int phase_shift, bool hakkero) {
+  if (!layer_touch(led_id)) return;
   uint8_t cnt_tmp = (general_cnt - phase_shift);
 
   if (S[led_id] < (255 - 50))
@@ -516,6 +585,7 @@ void MoePCB::masterspark(int led_id, int phase_shift, bool hakkero) {
 // マスパチャージ
 void MoePCB::masterspark_charge() {
   for (int led_id = 0; led_id < _led_num; led_id++) {
+    layer_touch(led_id);
     if (V_raw[led_id] < 80) V_raw[led_id] += 4.0;
     H[led_id] = random(30, 90);
     S[led_id] = 220;
@@ -524,32 +594,87 @@ void MoePCB::masterspark_charge() {
 //------------------------------------------------------------------------------------
 
 // 明るさを１段階追加する　最大→最小へ循環する
+// 次のフレームの頭でタイマー側が反映する
 void MoePCB::brightness_add(void) {
-  if (brightness == 0)
-    brightness = 1;
-  else if (brightness == 1)
-    brightness = 2;
-  else if (brightness == 2)
-    brightness = 3;
+  event_post(EV_BRIGHTNESS, BRIGHTNESS_NEXT, 0, 0);
+  // 了解コール
+  acknowledge();
+}
+
+// 明るさを変える　BRIGHTNESS_NEXTなら１段階追加
+void MoePCB::brightness_step(uint8_t level) {
+  if (level != BRIGHTNESS_NEXT)
+    _brightness = level;
+  else if (_brightness == 0)
+    _brightness = 1;
+  else if (_brightness == 1)
+    _brightness = 2;
+  else if (_brightness == 2)
+    _brightness = 3;
   else
-    brightness = 0;
+    _brightness = 0;
+  _brightness = constrain(_brightness, 0, 3);
 
   // イージングを無視してすぐに明るさを変更する
   // デフォルトのテーブルを使用しているため点灯モードによっては少しズレる(例:icyなど)
-  for (int i = 0; i < _led_num; i++) {
-    V[i] = _brightnessTable[brightness];
-    V_raw[i] = V[i];
+  // パターンの描画先(H,S,V...)を動かさないよう、各レイヤーの領域を直接書き換える
+  for (uint8_t l = 0; l < LAYER_NUM; l++) {
+    float *buf = _layers[l].buf;
+    if (buf == NULL) continue;
+    for (int i = 0; i < _led_num; i++) {
+      buf[_led_num * 2 + i] = _brightnessTable[_brightness];  // V
+      buf[_led_num * 4 + i] = _brightnessTable[_brightness];  // V_raw
+    }
+  }
+}
+
+//------------------------------------------------------------------------------------
+// 入力イベント
+
+// loop()側から投げる
+bool MoePCB::event_post(uint8_t type, uint8_t d0, uint8_t d1, uint8_t d2) {
+  return _events.push(type, d0, d1, d2);
+}
+
+// タイマー側で取り出す
+bool MoePCB::event_read(MoeEvent *ev) {
+  if (!_events.pop(ev)) return false;
+  // 明るさと気分は状態の変化としてtrace_tick()で記録する
+  if (_trace.active() && (ev->type != EV_BRIGHTNESS) && (ev->type != EV_MOOD)) {
+    uint16_t age = (uint16_t)(micros() >> 6) - ev->time;  // 64us単位
+    _trace.event(ev->type, ev->d0, ev->d1, ev->d2, min(age >> 1, 255));
+  }
+  event_apply(ev);
+  return true;
+}
+
+void MoePCB::event_apply(const MoeEvent *ev) {
+  switch (ev->type) {
+    case EV_MIDI: {
+      // 投げた時刻を復元してテンポ推定に使う
+      unsigned long now = micros();
+      uint16_t age = (uint16_t)(now >> 6) - ev->time;
+      _tempo.midi(ev->d0, ev->d1, ev->d2, now - ((unsigned long)age << 6));
+      break;
+    }
+    case EV_BRIGHTNESS:  // 割り込み中なので了解コールはしない
+      brightness_step(ev->d0);
+      break;
+    case EV_MOOD:
+      if (ev->d0 == MOOD_ANGRY) angry(ev->d1);
+      if (ev->d0 == MOOD_COLD) cold(ev->d1);
+      if (ev->d0 == MOOD_HEAT) heat(ev->d1);
+      if (ev->d0 == MOOD_DRUNK) drunk(ev->d1);
+      break;
   }
-  // 了解コール
-  acknowledge();
 }
 
 // 了解コール
 void MoePCB::acknowledge() {
-  digitalWrite(LED0, LOW);  // ON
-
   // タイマーが許可されていれば割り込み一時停止
-  if (_timer_enable) TIMSK4 = (0 << OCIE4A);  // 割り込み停止
+  if (_timer_enable) _timer.pause();  // 割り込み停止
+
+  led0(true);  // ON
 
   // タイマーが起動していなければfor文で無理やり時間を稼ぐ
   if (!_timer_enable) {
@@ -563,10 +688,10 @@ void MoePCB::acknowledge() {
   _pixels.show();
   delay(60);
 
-  // タイマーが許可されていれば割り込み一時停止
-  if (_timer_enable) TIMSK4 = (1 << OCIE4A);  // 割り込み再開
+  // タイマーが許可されていれば割り込み再開
+  led0(false);  // OFF
 
-  digitalWrite(LED0, HIGH);  // OFF
+  if (_timer_enable) _timer.resume();  // 割り込み再開
 }
 
 // モーフィング関数
@@ -586,91 +711,300 @@ float MoePCB::morph(float target_color, float H, uint8_t Gauge) {
   return tmp;
 }
 
+// MIDIメッセージを入力する
+void MoePCB::midi_input(uint8_t status, uint8_t data1, uint8_t data2) {
+  event_post(EV_MIDI, status, data1, data2);
+}
+
+// 何拍でカウンタを一周させるか
+void MoePCB::beat_lock(uint8_t beats) { _beat_lock = beats; }
+
+// アニメーション用カウンタを進める
+// 拍に合わせるときは、テンポの信頼度に応じて自走の送り量から拍に合わせた送り量へなめらかに切り替える
+void MoePCB::count(void) {
+  unsigned long now = micros();
+  uint32_t dt = now - _last_update_us;
+  _last_update_us = now;
+  if (dt < 100000) _tick_us += ((int32_t)dt - (int32_t)_tick_us) / 16;
+  _tempo.tick(now);
+
+  // 自走時の送り量　汎用・ゲーミングは8.8固定小数点
+  int32_t general_step = 256;
+  int32_t gaming_step = 6 * 256;
+  float rainbow_step = 1.2;
+
+  uint8_t conf = _beat_lock ? _tempo.Get_confidence() : 0;
+  if (conf) {
+    uint32_t beat;
+    uint8_t pos;
+    _tempo.phase(now, &beat, &pos);
+    uint32_t beat_us = _tempo.Get_beat_us();
+
+    // N拍で一周するときの今あるべき位置(8.8)と1フレームの送り量
+    uint16_t cycle_pos = ((((beat % _beat_lock) << 8) + pos) << 8) / _beat_lock;
+    // 割り込み中なので32bitで計算する　_tick_usは100ms未満なので4096倍まで収まり、
+    // 残りの16倍は割る側を1/16にする（1拍は16万us以上あるので誤差は無視できる）
+    int32_t lock_step = (_tick_us << 12) / ((beat_us * _beat_lock) >> 4);
+    // 位置のズレは1/8ずつ詰める
+    int16_t err = cycle_pos - (((uint16_t)general_cnt << 8) | _general_frac);
+    general_step += ((lock_step + err / 8 - general_step) * conf) >> 8;
+
+    // ゲーミングは1拍で一周
+    lock_step = (_tick_us << 12) / (beat_us >> 4);
+    err = ((uint16_t)pos << 8) - (((uint16_t)gaming_cnt << 8) | _gaming_frac);
+    gaming_step += ((lock_step + err / 8 - gaming_step) * conf) >> 8;
+
+    // 虹色は汎用カウンタと同じ周期
+    float rainbow_err = cycle_pos * (360.0 / 65536) - rainbow_cnt;
+    if (180 < rainbow_err) rainbow_err -= 360;
+    if (rainbow_err < -180) rainbow_err += 360;
+    float rainbow_lock = 360.0 * _tick_us / ((float)beat_us * _beat_lock);
+    rainbow_step += (rainbow_lock + rainbow_err / 8 - rainbow_step) * conf / 255;
+  }
+
+  // 虹色用カウンタ 0-360で一周（色環と一致）
+  rainbow_cnt += max(rainbow_step, 0);  // ゆっくり自動で色環指示値を回す
+  if (360 < rainbow_cnt)
+    rainbow_cnt -= 360;  // 色環が回ってしまったら一周分引く 0-360
+  if (rainbow_cnt < 0)
+    rainbow_cnt += 360;  // 色環が回ってしまったら一周分足す 0-360
+
+  // 汎用カウンタ
+  uint16_t acc = (((uint16_t)general_cnt << 8) | _general_frac) +
+                 max(general_step, 0);
+  general_cnt = acc >> 8;
+  _general_frac = acc;
+
+  // ゲーミングモード用カウンタ
+  acc = (((uint16_t)gaming_cnt << 8) | _gaming_frac) + max(gaming_step, 0);
+  gaming_cnt = acc >> 8;
+  _gaming_frac = acc;
+}
+
 // レベルメーターゲージに値を投入
 void MoePCB::lvmeter_input(int input_level) {
   _LevelMeter = constrain(input_level, 0, 300);
   if (_LevelPeak <= _LevelMeter) _LevelPeak = _LevelMeter;  // ピーク値を更新
 }
 
-void MoePCB::update() {
+//------------------------------------------------------------------------------------
+// 合成レイヤー
+
+// レイヤー１枚の大きさ　float６本(H,S,V,S_raw,V_raw,V_last)と色モード１本をLED数ぶん
+#define LAYER_FLOATS 6
+#define LAYER_BYTES(n) ((n) * (LAYER_FLOATS * sizeof(float) + 1))
+
+// レイヤーの領域を確保　H,S,V,S_raw,V_raw,V_lastの６本と色モードをLED数ぶん
+bool MoePCB::layer_alloc(uint8_t layer) {
+  if (LAYER_NUM <= layer) return false;
+  if (_layers[layer].buf == NULL)
+    _layers[layer].buf = (float *)calloc(1, LAYER_BYTES(_led_num));
+  return _layers[layer].buf != NULL;
+}
+
+// H,S,V...を指定レイヤーの領域に向ける
+void MoePCB::layer_select(uint8_t layer) {
+  _layer = layer;
+  float *buf = _layers[layer].buf;
+  H = buf;
+  S = buf + _led_num;
+  V = buf + _led_num * 2;
+  S_raw = buf + _led_num * 3;
+  V_raw = buf + _led_num * 4;
+  V_last = buf + _led_num * 5;
+  last_color_mode = (uint8_t *)(buf + _led_num * LAYER_FLOATS);
+}
+
+// オーバーレイを確保して合成方法を設定する　割り込み中にmallocしないようsetup()で呼ぶこと
+// 確保できなければfalse　最初は透明（不透明度0）
+bool MoePCB::layer_begin(uint8_t layer, uint8_t blend) {
+  if (!layer_alloc(layer)) return false;
+  _layers[layer].blend = blend;
+  if (layer != LAYER_BASE) layer_fade(layer, 0, 0);
+  return true;
+}
+
+// 描画先レイヤーを選ぶ　確保されていないレイヤーならベースに描く
+// update()が終わるとベースに戻る
+void MoePCB::layer(uint8_t layer) {
+  if ((LAYER_NUM <= layer) || (_layers[layer].buf == NULL)) layer = LAYER_BASE;
+  layer_draw_end();
+  _draw_us = micros() | 1;  // 切り替えたところから次のレイヤーの描画として計る
+  layer_select(layer);
+}
+
+// ここまでの時間を描画先レイヤーの描画時間に足す
+void MoePCB::layer_draw_end(void) {
+  if (_draw_us == 0) return;
+  _layers[_layer].draw_us += (micros() | 1) - _draw_us;
+  _draw_us = 0;
+}
+
+void MoePCB::layer_blend(uint8_t layer, uint8_t blend) {
+  if (LAYER_NUM <= layer) return;
+  _layers[layer].blend = blend;
+}
+
+// 不透明度を指定フレーム数かけて目標値まで直線的に変化させる
+// 残りの差を残りフレーム数で割って進めるので、差の大きさによらずちょうどそのフレーム数で届く
+// 同じ目標値に向かっている最中（到達済み含む）なら何もしないので毎フレーム呼んでもよい
+void MoePCB::layer_fade(uint8_t layer, uint8_t alpha, uint16_t ticks) {
+  if (LAYER_NUM <= layer) return;
+  MoeLayer *ly = &_layers[layer];
+  if ((1 < ticks) && (ly->alpha_target == alpha)) return;
+  ly->alpha_target = alpha;
+  if (ticks <= 1) {  // すぐに反映
+    ly->alpha = (uint16_t)alpha << 8;
+    ly->alpha_ticks = 0;
+    return;
+  }
+  ly->alpha_ticks = ticks;
+}
+
+// レイヤーの中身（指示値と追従値）を丸ごとコピーする
+// クロスフェードが終わったオーバーレイをベースに引き継ぐときに使う
+void MoePCB::layer_copy(uint8_t dst, uint8_t src) {
+  if ((LAYER_NUM <= dst) || (LAYER_NUM <= src)) return;
+  if ((_layers[dst].buf == NULL) || (_layers[src].buf == NULL)) return;
+  memcpy(_layers[dst].buf, _layers[src].buf, LAYER_BYTES(_led_num));
+}
+
+// 8bit固定小数点でRGBの各チャンネルを合成する
+uint32_t MoePCB::blend_color(uint32_t under, uint32_t over, uint8_t alpha,
+                             uint8_t mode) {
+  uint16_t a = alpha + (alpha >> 7);  // 0-256に広げて255で完全に上書きにする
+  uint32_t out = 0;
+  for (uint8_t shift = 0; shift < 24; shift += 8) {
+    uint8_t u = under >> shift;
+    uint8_t o = ((uint16_t)(uint8_t)(over >> shift) * a) >> 8;  // 不透明度を掛ける
+    uint16_t c;
+    if (mode == BLEND_ADD) {
+      c = min(u + o, 255);
+    } else if (mode == BLEND_MAX) {
+      c = max(u, o);
+    } else {  // BLEND_NORMAL
+      c = o + (((uint16_t)u * (256 - a)) >> 8);
+    }
+    out |= (uint32_t)c << shift;
+  }
+  return out;
+}
+
+//------------------------------------------------------------------------------------
+// 指示値への追従とゲージ処理　描画先レイヤーのLEDひとつ分を計算してRGB値を返す
+uint32_t MoePCB::ease(int i) {
   // Hは色環度数の指示値（0-359）
   // Sは彩度指示値（0-255）
   // Vは照度指示値（0-255）
 
-  for (int i = 0; i < _led_num;
-       i++) {  // LEDの数だけ計算を繰り返す。V[n]で指示した値にV_raw[n]が追従
-
-    // 色環計算関係
-
-    // 寒さゲージによって彩度を上書きモーフィングする。最終地点の色環に近い方に回す仕組みを採用
-    // ターゲット色、現在色環、モーフィングゲージ（0-255）
-    H[i] = morph(190, H[i], ColdGauge);
-
-    // 暑さゲージによって彩度を上書きモーフィングする。最終地点の色環に近い方に回す仕組みを採用
-    // ターゲット色、現在色環、モーフィングゲージ（0-255）
-    H[i] = morph(0, H[i], HeatGauge);
-
-    // 酔いゲージによって彩度を上書きモーフィングする。最終地点の色環に近い方に回す仕組みを採用
-    // ターゲット色、現在色環、モーフィングゲージ（0-255）
-    H[i] = morph(-7, H[i], DrunkGauge);
-
-    // 怒りゲージによって彩度を上書きモーフィングする。最終地点の色環に近い方に回す仕組みを採用
-    // ターゲット色、現在色環、モーフィングゲージ（0-255）
-    H[i] = morph(-7, H[i], FuryGauge);
-
-    // 指示値を実値に反映
-    H_raw[i] = H[i];
-
-    if (360 < H_raw[i]) H_raw[i] -= 360;  // 色環が回ってしまったら一周分引く
-    if (H_raw[i] < 0) H_raw[i] += 360;  // 色環が回ってしまったら一周分足す
-
-    // 彩度計算関係
-    // 設定値と現実の値の差分で加減速
-    S_raw[i] += (S[i] - S_raw[i]) / 10;
-    // 怒りゲージにより彩度設定を無視して最大彩度になる
-    S_raw[i] = max(S_raw[i], FuryGauge);
-    // 寒さゲージにより彩度設定を無視して最大彩度になる
-    S_raw[i] = max(S_raw[i], ColdGauge);
-    // 暑さゲージにより彩度設定を無視して最大彩度になる
-    S_raw[i] = max(S_raw[i], HeatGauge);
-    // 酔いゲージにより彩度設定を無視して最大彩度になる
-    S_raw[i] = max(S_raw[i], DrunkGauge);
-
-    S_raw[i] = constrain(S_raw[i], 0, 255);  // 値を制限
-    S[i] = constrain(S[i], 0, 255);          // 値を制限
-
-    // 照度計算関係
-    if (V_raw[i] <
-        16) {  // 比例計算していると０近くの動きが鈍くなるので、０に近づいたら純粋に一定値で増減させる
-      if (V_raw[i] > V[i])
-        V_raw[i] -= 0.5;  // 設定値より現実の値が高ければ徐々に減算
-      if (V_raw[i] < V[i])
-        V_raw[i] += 0.5;  // 設定値より現実の値が低ければ徐々に加算
-    } else {
-      V_raw[i] += (V[i] - V_raw[i]) / 30;  // 設定値と現実の値の差分で加減速
-    }
-    // 怒りゲージにより明るさ設定を無視して最大輝度になる
-    V_raw[i] = max(V_raw[i], FuryGauge) - pulsation;
-    V_raw[i] = constrain(V_raw[i], 0, 255);  // 値を制限
-    V[i] = constrain(V[i], 0, 255);          // 値を制限
+  // 色環計算関係
+
+  // 寒さゲージによって彩度を上書きモーフィングする。最終地点の色環に近い方に回す仕組みを採用
+  // ターゲット色、現在色環、モーフィングゲージ（0-255）
+  H[i] = morph(190, H[i], ColdGauge);
+
+  // 暑さゲージによって彩度を上書きモーフィングする。最終地点の色環に近い方に回す仕組みを採用
+  // ターゲット色、現在色環、モーフィングゲージ（0-255）
+  H[i] = morph(0, H[i], HeatGauge);
+
+  // 酔いゲージによって彩度を上書きモーフィングする。最終地点の色環に近い方に回す仕組みを採用
+  // ターゲット色、現在色環、モーフィングゲージ（0-255）
+  H[i] = morph(-7, H[i], DrunkGauge);
+
+  // 怒りゲージによって彩度を上書きモーフィングする。最終地点の色環に近い方に回す仕組みを採用
+  // ターゲット色、現在色環、モーフィングゲージ（0-255）
+  H[i] = morph(-7, H[i], FuryGauge);
+
+  // 指示値を実値に反映
+  float H_raw = H[i];
+
+  if (360 < H_raw) H_raw -= 360;  // 色環が回ってしまったら一周分引く
+  if (H_raw < 0) H_raw += 360;    // 色環が回ってしまったら一周分足す
+
+  // 彩度計算関係
+  // 設定値と現実の値の差分で加減速
+  S_raw[i] += (S[i] - S_raw[i]) / 10;
+  // 怒りゲージにより彩度設定を無視して最大彩度になる
+  S_raw[i] = max(S_raw[i], FuryGauge);
+  // 寒さゲージにより彩度設定を無視して最大彩度になる
+  S_raw[i] = max(S_raw[i], ColdGauge);
+  // 暑さゲージにより彩度設定を無視して最大彩度になる
+  S_raw[i] = max(S_raw[i], HeatGauge);
+  // 酔いゲージにより彩度設定を無視して最大彩度になる
+  S_raw[i] = max(S_raw[i], DrunkGauge);
+
+  S_raw[i] = constrain(S_raw[i], 0, 255);  // 値を制限
+  S[i] = constrain(S[i], 0, 255);          // 値を制限
+
+  // 照度計算関係
+  if (V_raw[i] <
+      16) {  // 比例計算していると０近くの動きが鈍くなるので、０に近づいたら純粋に一定値で増減させる
+    if (V_raw[i] > V[i])
+      V_raw[i] -= 0.5;  // 設定値より現実の値が高ければ徐々に減算
+    if (V_raw[i] < V[i])
+      V_raw[i] += 0.5;  // 設定値より現実の値が低ければ徐々に加算
+  } else {
+    V_raw[i] += (V[i] - V_raw[i]) / 30;  // 設定値と現実の値の差分で加減速
+  }
+  // 怒りゲージにより明るさ設定を無視して最大輝度になる
+  V_raw[i] = max(V_raw[i], FuryGauge) - pulsation;
+  V_raw[i] = constrain(V_raw[i], 0, 255);  // 値を制限
+  V[i] = constrain(V[i], 0, 255);          // 値を制限
+
+  return _pixels.ColorHSV(map(H_raw, 0, 360, 0, 65535), S_raw[i], V_raw[i]);
+}
 
-    // LEDごとに値を送信
-    _pixels.setPixelColor(i, _pixels.ColorHSV(map(H_raw[i], 0, 360, 0, 65535),
-                                              S_raw[i], V_raw[i]));
+void MoePCB::update() {
+  // MoePCB_Task()で読み残したイベントを反映　ライブラリが扱わないものは数えて捨てる
+  MoeEvent ev;
+  while (event_read(&ev)) {
+    if ((ev.type != EV_MIDI) && (ev.type != EV_BRIGHTNESS) &&
+        (ev.type != EV_MOOD))
+      _event_unread++;
   }
 
-  // 虹色用カウンタ 0-360で一周（色環と一致）
-  rainbow_cnt += 1.2;  // ゆっくり自動で色環指示値を回す
-  if (360 < rainbow_cnt)
-    rainbow_cnt -= 360;  // 色環が回ってしまったら一周分引く 0-360
-  if (rainbow_cnt < 0)
-    rainbow_cnt += 360;  // 色環が回ってしまったら一周分足す 0-360
+  layer_draw_end();  // パターン関数の描画時間はここまで
+
+  // レイヤーごとに計算して下から順に重ねる
+  // 透明なオーバーレイと、このフレームでパターンが書き込んでいないLEDは計算自体を省略する
+  // 処理時間はパターン関数の描画時間と合わせてレイヤーごとに残す
+  for (uint8_t l = 0; l < LAYER_NUM; l++) {
+    MoeLayer *ly = &_layers[l];
+    uint8_t alpha = ly->alpha >> 8;
+    ly->cost_us = ly->draw_us;
+    ly->draw_us = 0;
+    if ((ly->buf == NULL) || ((l != LAYER_BASE) && (alpha == 0))) continue;
+    unsigned long start_us = micros();
+    layer_select(l);
+
+    for (int i = 0; i < _led_num;
+         i++) {  // LEDの数だけ計算を繰り返す。V[n]で指示した値にV_raw[n]が追従
+      if (l == LAYER_BASE) {
+        uint32_t c = ease(i);
+        // ベースの不透明度は黒に対してのフェード
+        if (alpha != 255) c = blend_color(0, c, alpha, BLEND_NORMAL);
+        _pixels.setPixelColor(i, c);
+      } else if (ly->mask & ((uint32_t)1 << i)) {
+        _pixels.setPixelColor(i, blend_color(_pixels.getPixelColor(i), ease(i),
+                                             alpha, ly->blend));
+      }
+    }
+    ly->cost_us += micros() - start_us;
+  }
 
-  // 汎用カウンタ
-  general_cnt += 1;
+  // 不透明度のアニメーション
+  for (uint8_t l = 0; l < LAYER_NUM; l++) {
+    MoeLayer *ly = &_layers[l];
+    ly->mask = 0;  // 書き込み済みLEDはフレームごとにクリア
+    if (ly->alpha_ticks == 0) continue;
+    int32_t goal = (int32_t)ly->alpha_target << 8;
+    ly->alpha += (goal - (int32_t)ly->alpha) / ly->alpha_ticks;  // 最後のフレームでちょうど届く
+    ly->alpha_ticks--;
+  }
+  layer_select(LAYER_BASE);  // 次のフレームはベースから描く
 
-  // ゲーミングモード用カウンタ
-  gaming_cnt += 6;
+  uint32_t frame_us = micros() - _last_update_us;  // 記録用　count()の前に測る
+  count();
 
   // レベルメーター
   // if(0<(_LevelMeter-5)) _LevelMeter = _LevelMeter - 5;
@@ -681,16 +1015,11 @@ void MoePCB::update() {
   if (0 < _LevelPeak) _LevelPeak -= (_LevelPeak) / 30;
   if (0 < _LevelPeak) _LevelPeak -= 1;
 
-  // 明るさ
-  _brightness = constrain(brightness, 0, 3);
-
+  power_update();  // 電流の上限を超えるなら全体を暗くする
   _pixels.show();  // 一斉に更新
 
-  digitalWrite(LED0, HIGH);  // OFF
-
   // 怒りフラグが立ったらゲージを自動で増減する
   if (angly_flag) {
-    digitalWrite(LED0, LOW);  // ON
     if (250 < FuryGauge) {    // ゲージが増えていったら
       pulsation += 8;  // 脈動のためのゲージをチャージする
       if (160 < pulsation) pulsation = 0;
@@ -705,7 +1034,6 @@ void MoePCB::update() {
 
   // 寒さフラグが立ったらゲージを自動で増減する
   if (cold_flag) {
-    digitalWrite(LED0, LOW);  // ON
     if ((ColdGauge) < 255) ColdGauge = ColdGauge + 1;
   } else {
     if (0 < ColdGauge) ColdGauge = ColdGauge - 1;
@@ -713,7 +1041,6 @@ void MoePCB::update() {
 
   // 暑さフラグが立ったらゲージを自動で増減する
   if (heat_flag) {
-    digitalWrite(LED0, LOW);  // ON
     if ((HeatGauge) < 255) HeatGauge = HeatGauge + 1;
   } else {
     if (0 < HeatGauge) HeatGauge = HeatGauge - 1;
@@ -721,9 +1048,162 @@ void MoePCB::update() {
 
   // 酔いフラグが立ったらゲージを自動で増減する
   if (drunk_flag) {
-    digitalWrite(LED0, LOW);  // ON
     if ((DrunkGauge) < 255) DrunkGauge = DrunkGauge + 1;
   } else {
     if (0 < DrunkGauge) DrunkGauge = DrunkGauge - 1;
   }
+
+  // 何かのフラグが立っている間は背面LEDを点ける　RGBLEDの領域が無いときは点けっぱなし
+  led0(angly_flag || cold_flag || heat_flag || drunk_flag ||
+       (_layers[LAYER_BASE].buf == NULL));
+
+  aux_update();
+
+  if (_trace.active()) trace_tick(frame_us);
+}
+
+//------------------------------------------------------------------------------------
+// 消費電流の制限
+
+void MoePCB::power_limit(uint16_t mA) { _power_limit = mA; }
+
+void MoePCB::power_update(void) {
+  uint8_t *p = _pixels.getPixels();
+  uint8_t n = _led_num * 3;
+  uint16_t sum = 0;  // GRB値の合計　最大30個×3色×255でも16bitに収まる
+  for (uint8_t i = 0; i < n; i++) sum += p[i];
+  uint16_t idle = (uint16_t)POWER_MA_IDLE * _led_num;
+  _demand_mA = idle + (uint32_t)sum * POWER_MA_CHANNEL / 255;
+
+  uint16_t target = 256;
+  if (_power_limit && (_power_limit < _demand_mA) && sum) {
+    // 上限に収まるGRB値の合計から倍率を求める
+    uint32_t allow = 0;
+    if (idle < _power_limit)
+      allow = (uint32_t)(_power_limit - idle) * 255 / POWER_MA_CHANNEL;
+    target = allow * 256 / sum;
+  }
+  if (target < _power_scale)
+    _power_scale = target;  // 超えたらすぐ下げる
+  else
+    _power_scale += (target - _power_scale + 15) / 16;  // 戻すのはゆっくり
+
+  if (_power_scale < 256) {
+    sum = 0;
+    for (uint8_t i = 0; i < n; i++) {
+      p[i] = ((uint16_t)p[i] * _power_scale) >> 8;
+      sum += p[i];
+    }
+    _power_limited++;
+  }
+  _current_mA = idle + (uint32_t)sum * POWER_MA_CHANNEL / 255;
+}
+
+//------------------------------------------------------------------------------------
+// 入力の記録
+
+bool MoePCB::trace_begin(uint16_t bytes) {
+  // 乱数の種も記録して、再生側でパターンの乱数を同じ系列から始める
+  uint32_t seed = micros() | 1;
+  if (!_trace.begin(bytes, _led_num, seed)) return false;
+  randomSeed(seed);
+  _trace_brightness = _brightness;
+  _trace_mood = 0;
+  trace_tick(0);  // 記録開始時点で立っているフラグも残す
+  return true;
+}
+
+void MoePCB::trace_end(void) { _trace.end(); }
+
+void MoePCB::trace_dump(Print &out) {
+  // 書き出し中に記録が進まないよう割り込みを止める
+  if (_timer_enable) _timer.pause();
+  _trace.dump(out);
+  if (_timer_enable) _timer.resume();
+}
+
+// このフレームまでに変わった明るさ・気分をイベントとして残してからフレームを区切る
+// 再生時は区切りの前のイベントを投げてからMoePCB_Task()を呼ぶ
+void MoePCB::trace_tick(uint32_t frame_us) {
+  if (_brightness != _trace_brightness) {
+    _trace_brightness = _brightness;
+    _trace.event(EV_BRIGHTNESS, _brightness, 0, 0, 0);
+  }
+  uint8_t mood = (angly_flag << MOOD_ANGRY) | (cold_flag << MOOD_COLD) |
+                 (heat_flag << MOOD_HEAT) | (drunk_flag << MOOD_DRUNK);
+  for (uint8_t m = MOOD_ANGRY; m <= MOOD_DRUNK; m++) {
+    if (((mood ^ _trace_mood) >> m) & 1)
+      _trace.event(EV_MOOD, m, (mood >> m) & 1, 0, 0);
+  }
+  _trace_mood = mood;
+  if (frame_us) _trace.tick(frame_us);
+}
+
+//------------------------------------------------------------------------------------
+// 単色PWM LED
+
+bool MoePCB::aux_begin(uint8_t ch, uint8_t pin) {
+  if (AUX_NUM <= ch) return false;
+  // PWMの無いピンはanalogWrite()しても点くか消えるかだけになる
+  // pin_timer()はタイマー０(D3,D11)を0で返すので、PWMの有無はdigitalPinToTimer()で見る
+  if (digitalPinToTimer(pin) == NOT_ON_TIMER) return false;
+  if ((pin == LED0) || (pin == RGBLED_PIN)) return false;  // 背面LEDとRGBLED
+  uint8_t timer = MoeTimer::pin_timer(pin);
+  // 定期実行タイマーのPWMを使うとanalogWrite()で割り込み周期が壊れる
+  // begin()前はタイマーを動かすかまだわからないので断っておく
+  if ((!_begun || _timer_enable) && (timer == _timer.Get_timer())) return false;
+  _timer.claim_pin(pin);  // タイマーを選び直しても衝突しないよう登録
+  pinMode(pin, OUTPUT);
+  analogWrite(pin, 0);
+  _aux[ch].pin = pin;
+  _aux[ch].target = 0;
+  _aux[ch].level = 0;
+  _aux[ch].out = 0;
+  return true;
+}
+
+void MoePCB::aux(uint8_t ch, uint8_t level) {
+  if (AUX_NUM <= ch) return;
+  _aux[ch].target = level;
+}
+
+// 追従値だけを上げるので、そのあと指示値に向かってゆっくり戻る
+void MoePCB::aux_flash(uint8_t ch, uint8_t level) {
+  if (AUX_NUM <= ch) return;
+  if (_aux[ch].level < ((uint16_t)level << 8)) _aux[ch].level = (uint16_t)level << 8;
+}
+
+void MoePCB::aux_update(void) {
+  for (uint8_t c = 0; c < AUX_NUM; c++) {
+    MoeAux *a = &_aux[c];
+    if (a->pin == AUX_NO_PIN) continue;
+
+    // V_rawと同じ追従　０に近づいたら一定値で増減、それ以外は差分で加減速
+    int32_t level = a->level;
+    int32_t target = (int32_t)a->target << 8;
+    if (level < (16L << 8)) {
+      if (target < level) level -= 128;  // 0.5
+      if (level < target) level += 128;
+    } else {
+      level += (target - level) / 30;
+    }
+    // 怒りゲージにより最大輝度になり、脈動する
+    level = max(level, (int32_t)FuryGauge << 8) - ((int32_t)pulsation << 8);
+    level = constrain(level, 0, 255L << 8);
+    a->level = level;
+
+    uint8_t out = ((uint16_t)pgm_read_byte(&aux_curve[level >> 8]) *
+                   _auxScaleTable[_brightness]) >> 8;
+    if (out != a->out) {  // 変化したときだけ書き込む
+      analogWrite(a->pin, out);
+      a->out = out;
+    }
+  }
+}
+
+// 背面LEDはLOWで点灯
+void MoePCB::led0(bool on) {
+  if (on == _led0) return;
+  _led0 = on;
+  digitalWrite(LED0, on ? LOW : HIGH);
 }
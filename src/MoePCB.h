@@ -11,6 +11,12 @@
 #include <Adafruit_NeoPixel.h>
 
 #include "Arduino.h"
+#include "MoeBoard.h"
+#include "MoeEvent.h"
+#include "MoePalette.h"
+#include "MoeTempo.h"
+#include "MoeTimer.h"
+#include "MoeTrace.h"
 
 #define LED0 13       // 通常の単色LED接続ピン
 #define RGBLED_PIN 6  // NeoPixel接続ピン
@@ -46,6 +52,10 @@
 #define LED21 20
 
 // 基板IF
+#define FRAN 0001
+#define CIRNO 0002
+#define HINA 0003
+#define TENSHI 0004
 #define PATCHU 0005
 #define MARISA 0006
 #define YUKARI 0007
@@ -60,11 +70,57 @@
 #define RIBBON_R 6
 #define RIBBON_LR 7
 
+// 合成レイヤー
+#define LAYER_NUM 3    // レイヤー数（ベース＋オーバーレイ２枚）
+#define LAYER_BASE 0   // ベースレイヤー（常に確保される）
+#define LAYER_OVER1 1  // オーバーレイ１
+#define LAYER_OVER2 2  // オーバーレイ２
+
+// レイヤーの合成方法
+#define BLEND_NORMAL 0  // 不透明度に応じて下のレイヤーと混ぜる（クロスフェード）
+#define BLEND_ADD 1     // 下のレイヤーに加算
+#define BLEND_MAX 2     // 下のレイヤーと比べて明るい方
+
+// 単色PWM LEDの補助チャンネル
+#define AUX_NUM 4  // 補助チャンネル数
+#define AUX1 0
+#define AUX2 1
+#define AUX3 2
+#define AUX4 3
+#define AUX_NO_PIN 0xFF  // 未使用のチャンネル
+
+// 消費電流の見積もり（WS2812B相当）
+#define POWER_MA_CHANNEL 20  // RGBの１色を255で点けたときの電流(mA)
+#define POWER_MA_IDLE 1      // 消灯していてもLED１個に流れる電流(mA)
+
+// 補助チャンネルの指示値・追従値
+struct MoeAux {
+  uint8_t pin;     // 接続ピン（未使用ならAUX_NO_PIN）
+  uint8_t target;  // 明るさ指示値 0-255（見た目の明るさ）
+  uint16_t level;  // 明るさ追従値 8.8固定小数点
+  uint8_t out;     // 最後にanalogWrite()した値
+};
+
+// レイヤーごとのHSV指示値・追従値と不透明度
+struct MoeLayer {
+  // H,S,V,S_raw,V_raw,V_last(float)と色モード(uint8_t)をLED数ぶん並べた領域（未確保ならNULL）
+  float *buf;
+  uint32_t mask;  // このフレームでパターンが書き込んだLED（オーバーレイのみ使用）
+  uint16_t alpha;        // 現在の不透明度 8.8固定小数点（上位8bitが0-255）
+  uint16_t alpha_ticks;  // 目標値に届くまでの残りフレーム数　0なら止まっている
+  uint8_t alpha_target;  // 不透明度の目標値 0-255
+  uint8_t blend;         // 合成方法
+  uint16_t draw_us;      // このフレームでパターン関数の描画にかかった時間(us)
+  uint16_t cost_us;      // 前回のフレームの描画と合成にかかった時間(us)
+  int8_t twinkle_last;   // 1回前にピカッとしたLEDの番号（同じLEDを連続で光らせない）
+};
+
 class MoePCB : public Adafruit_NeoPixel {
  public:
   // LED数を与えてインスタンスを作成する
   MoePCB(uint8_t);
 
+  void board(uint8_t);    // 基板ID(FRANなど)　begin()より前に呼ぶと位相マップを作る
   void begin(bool);       // 開始処理 タイマー有効無効切り替え
   void begin(void);       // 開始処理デフォルトではタイマー無効
   void update(void);      // 自動インターポーレート
@@ -81,6 +137,10 @@ class MoePCB : public Adafruit_NeoPixel {
                       uint8_t);  // 光らせたいLED番号、LEDのポジション(256段階)
   void autumn(int, int);  // 光らせたいLED番号、ベース色からの差分
   void gaming(int, int);  // 光らせたいLED番号、ベース色からの差分
+  // 光らせたいLED番号、パレット、位相差　パレットはPALETTE_AUTUMNなどか
+  // スケッチで const MoeColor 名前[PALETTE_STOPS] PROGMEM = {{色環, 彩度}, ...}; と作る
+  // パレットは最後の色から最初の色へ戻りながら巡るので、両端が近い色になるように作る
+  void gradient(int, const MoeColor *, int);
   void sword(
       int, int, uint8_t,
       uint8_t);  // 光らせたいLED番号、ベース色からの差分、点灯サブパターン
@@ -89,13 +149,72 @@ class MoePCB : public Adafruit_NeoPixel {
       uint8_t);  // 光らせたいLED番号、レベルメーターの範囲を0-255と仮定してそのうちどこにアタッチしたいか
   void lvmeter_input(
       int);  // レベルメーターへの値の入力（0-255）一応300くらいまでは受け付けている
+  // MIDIメッセージの入力（ステータス、データ1、データ2）　クロックとノートオンからテンポを推定する
+  // イベントキュー経由なのでloop()から呼んでよい
+  void midi_input(uint8_t, uint8_t, uint8_t);
+  // 何拍で呼吸・虹色が一周するか（ゲーミングは1拍で一周）0で拍に合わせない
+  void beat_lock(uint8_t);
   void masterspark_charge(void);  // チャージ状態
   void masterspark(int, int);  // 光らせたいLED番号、パターンの位相差
   void masterspark(int, int, bool);  // 光らせたいLED番号、パターンの位相差
-  uint8_t brightness = 1;  // 明るさ　0-3の４段階
 
-  void brightness_add();  // 明るさを１段階追加する　最大→最小へ循環
+  // 明るさ　0-3の４段階（初期値1）
+  // 割り込み中に読むので直接は書き換えず、EV_BRIGHTNESSイベントかbrightness_add()で変える
+  void brightness_add();  // 明るさを１段階追加する　最大→最小へ循環（了解コール付き）
   void acknowledge();  // 了解コール
+
+  // 入力イベント　loop()側で投げて、タイマー側のMoePCB_Task()の先頭でevent_read()する
+  // 明るさ・MIDI・気分のイベントはevent_read()で取り出したときにライブラリが反映する
+  // 読み残したイベントはupdate()の最初にまとめて反映する
+  // ライブラリが扱わない種類（EV_TOUCHなど）は捨ててGet_event_unread()に数える
+  bool event_post(uint8_t, uint8_t, uint8_t, uint8_t);  // 種類、データ0-2　満杯ならfalse
+  bool event_read(MoeEvent *);  // 次のイベントを取り出す　無ければfalse
+
+  // 入力の記録　読み出したイベントと明るさ・気分の変化をフレームごとに貯める
+  // 書き出した記録はextras/replayでPC上に再生できる
+  bool trace_begin(uint16_t);  // 記録に使うバイト数　確保できなければfalse
+  void trace_end(void);        // 記録をやめて領域を解放
+  void trace_dump(Print &);    // 記録を書き出す　例：Yukari.trace_dump(Serial);
+
+  // 定期実行タイマー　begin(true)より前に呼ぶ
+  // デフォルトはタイマー４・50Hz　タイマー１・３も選べる
+  // IRremoteなど他のライブラリが同じタイマーの割り込みを持っていればそちらが優先されるので
+  // そのタイマーはtimer_claim()で宣言しておくこと
+  void timer(uint8_t, uint8_t);  // 使うタイマー(MOE_TIMERn)、周期(Hz)
+  void timer_claim(uint8_t);  // 他のライブラリが使うタイマー(MOE_TIMERn)を宣言
+  bool timer_check(void);  // 開始後に他のライブラリにタイマーを書き換えられていないか
+
+  // 基板上の位置から求めた位相(0-255)　board()していないか、並びの表が無い基板なら0
+  // 並びはサンプルスケッチから起こした概略（MoeBoard.cpp）
+  // 例：Fran.rainbow(LED3, Fran.phase_deg(LED3, SWEEP_ANGLE), A);
+  uint8_t phase(int, uint8_t);  // 光らせたいLED番号、SWEEP_LINEARなど
+  int phase_deg(int led_id, uint8_t sweep) {  // 色環の位相差用（0-359）
+    return ((uint16_t)phase(led_id, sweep) * 45) >> 5;
+  }
+
+  // 合成レイヤー
+  // オーバーレイはsetup()でlayer_begin()してから使う
+  bool layer_begin(uint8_t, uint8_t);  // レイヤー番号、合成方法
+  void layer(uint8_t);  // これ以降のパターン関数の描画先レイヤーを選ぶ
+  void layer_blend(uint8_t, uint8_t);  // レイヤー番号、合成方法
+  // レイヤー番号、目標の不透明度(0-255)、到達までのフレーム数（0ですぐ）
+  void layer_fade(uint8_t, uint8_t, uint16_t);
+  void layer_copy(uint8_t, uint8_t);  // コピー先レイヤー、コピー元レイヤー
+  // RGB値を合成する　下の色、上の色、上の不透明度(0-255)、合成方法
+  static uint32_t blend_color(uint32_t, uint32_t, uint8_t, uint8_t);
+
+  // 単色PWM LED（補助チャンネル）　RGBLEDと同じように指示値へ追従し、怒りゲージと明るさ設定が効く
+  // 使えるのはPWMのあるピン（D3,D5,D9,D10,D11）　背面LEDのD13とRGBLEDのD6は使えない
+  // 定期実行タイマーが動いているとき（begin(true)の後）と、まだ動かすかわからないbegin()前は
+  // そのタイマーのピンも使えない（タイマー１を選んだらD9,D10）　begin(false)の後なら使える
+  bool aux_begin(uint8_t, uint8_t);  // チャンネル、ピン　使えないピンならfalse
+  void aux(uint8_t, uint8_t);        // チャンネル、明るさ指示値(0-255)
+  void aux_flash(uint8_t, uint8_t);  // チャンネル、明るさ　追従値をすぐその明るさまで上げる
+
+  // 消費電流の制限　RGBLEDの見積もり電流が上限を超えるフレームは全体を暗くする
+  // 超えたらすぐ暗くして、戻すときは約１秒かけてゆっくり戻す
+  void power_limit(uint16_t);  // RGBLEDに使ってよい電流(mA)　0で制限しない（デフォルト）
+
   void angry(bool);
   void cold(bool);
   void heat(bool);
@@ -109,38 +228,79 @@ class MoePCB : public Adafruit_NeoPixel {
   uint8_t Get_FuryGauge(void) { return FuryGauge; }
   uint8_t Get_pulsation(void) { return pulsation; }
   uint8_t Get_gaming_cnt(void) { return gaming_cnt; }
+  // 最後に出力したPWM値　範囲外のチャンネルは0
+  uint8_t Get_aux(uint8_t ch) { return (ch < AUX_NUM) ? _aux[ch].out : 0; }
+  // 範囲外のレイヤーは0
+  uint8_t Get_layer_alpha(uint8_t layer) {
+    return (layer < LAYER_NUM) ? _layers[layer].alpha >> 8 : 0;
+  }
+  // 前回のフレームでそのレイヤーのパターン関数とupdate()の合成にかかった時間(us)
+  uint16_t Get_layer_cost(uint8_t layer) {
+    return (layer < LAYER_NUM) ? _layers[layer].cost_us : 0;
+  }
+  uint16_t Get_current(void) { return _current_mA; }  // 前回のフレームの見積もり電流(mA)
+  uint16_t Get_current_demand(void) { return _demand_mA; }  // 制限する前の見積もり電流(mA)
+  uint16_t Get_power_scale(void) { return _power_scale; }  // 今の倍率（256で制限なし）
+  uint32_t Get_power_limited(void) { return _power_limited; }  // 暗くしたフレーム数
+  uint8_t Get_timer_conflict(void) { return _timer.Get_conflict(); }
+  uint16_t Get_event_overflow(void) { return _events.Get_overflow(); }
+  uint16_t Get_event_unread(void) { return _event_unread; }  // 読まれずに捨てた数
+  uint8_t Get_brightness(void) { return _brightness; }  // 明るさ 0-3
+  uint16_t Get_trace_used(void) { return _trace.Get_used(); }  // 記録済みのバイト数
+  bool Get_trace_wrapped(void) { return _trace.Get_wrapped(); }  // 古い記録を捨てたか
+  float Get_bpm(void) { return 60000000.0 / _tempo.Get_beat_us(); }
+  uint8_t Get_tempo_confidence(void) { return _tempo.Get_confidence(); }
+  uint32_t Get_tempo_jitter(void) { return _tempo.Get_jitter_us(); }  // us
 
  private:
   // 明るさレベルに応じた明るさ値
   const uint8_t _brightnessTable[4] = {10, 25, 65, 175};
   // 明るさレベルに応じたランダムで変更するきらきら値
   const uint8_t _twinkleTable[4] = {40, 65, 155, 255};
+  // 明るさレベルに応じた補助チャンネルの出力倍率（256で等倍）
+  const uint16_t _auxScaleTable[4] = {64, 128, 256, 256};
 
   Adafruit_NeoPixel _pixels;
   bool _timer_enable;   // タイマー使うかどうかの保存
-  uint8_t _brightness;  // 明るさ 0-3
+  bool _begun;          // begin()済み
+  MoeTimer _timer;      // 定期実行タイマー
+  uint8_t _brightness;  // 明るさ 0-3　タイマー側（イベント）だけが書き換える
   uint8_t _led_num;     // LEDの個数を保存
-  float H_raw
-      [MAX_LED_NUM];  // LEDの彩度追従値
-                      // 0-255　雑にMAX_LED_NUM個分で初期化しているので暇があれば最適化すること
-  float S_raw
-      [MAX_LED_NUM];  // LEDの彩度追従値
-                      // 0-255　雑にMAX_LED_NUM個分で初期化しているので暇があれば最適化すること
-  float V_raw
-      [MAX_LED_NUM];  // LEDの照度追従値
-                      // 0-255　雑にMAX_LED_NUM個分で初期化しているので暇があれば最適化すること
-
-  float H[MAX_LED_NUM];
-  float S
-      [MAX_LED_NUM];  // LEDの彩度指示値
-                      // 0-255　雑にMAX_LED_NUM個分で初期化しているので暇があれば最適化すること
-  float V
-      [MAX_LED_NUM];  // LEDの照度指示値
-                      // 0-255　雑にMAX_LED_NUM個分で初期化しているので暇があれば最適化すること
+  uint8_t _board;       // 基板ID 0なら未指定
+  uint8_t *_phase;      // 位相マップ SWEEP_NUM×LED数（未作成ならNULL）
+  MoeAux _aux[AUX_NUM];         // 単色PWM LED
+  bool _led0;                   // 背面LEDの点灯状態
+  uint16_t _power_limit;        // RGBLEDの電流上限(mA) 0なら制限しない
+  uint16_t _power_scale;        // 全体に掛ける倍率（256で等倍）
+  uint16_t _current_mA;         // 制限後の見積もり電流(mA)
+  uint16_t _demand_mA;          // 制限前の見積もり電流(mA)
+  uint32_t _power_limited;      // 暗くしたフレーム数
+  MoeLayer _layers[LAYER_NUM];  // 合成レイヤー
+  uint8_t _layer;               // 描画先レイヤー
+  unsigned long _draw_us;       // 描画先レイヤーの描画を計り始めた時刻 0なら未開始
+  // 描画先レイヤーのHSV指示値・追従値 0-255（色環は0-360）
+  float *H;      // LEDの色環指示値
+  float *S;      // LEDの彩度指示値
+  float *V;      // LEDの照度指示値
+  float *S_raw;  // LEDの彩度追従値
+  float *V_raw;  // LEDの照度追従値
+  float *V_last;  // ピカッとしたときの照度（icy・twinklestarなど）
+  uint8_t *last_color_mode;  // swordの前回の色モード
 
   uint8_t general_cnt;  // 汎用カウンタ(0-255)
   float rainbow_cnt;  // レインボーモードのカウンタ　色環に一致（0-360）
   uint8_t gaming_cnt;  // ゲーミングモード用カウンタ (0-255)
+  uint8_t _general_frac;  // 汎用カウンタの小数部（拍に合わせるときに使う）
+  uint8_t _gaming_frac;   // ゲーミングモード用カウンタの小数部
+  MoeTempo _tempo;        // MIDIから推定したテンポ
+  MoeEventQueue _events;  // loop()から受け取った入力イベント
+  uint16_t _event_unread;  // スケッチに読まれずupdate()で捨てたイベントの数
+  MoeTrace _trace;        // 入力の記録
+  uint8_t _trace_brightness;  // 前回記録した明るさ
+  uint8_t _trace_mood;        // 前回記録した気分フラグ（MOOD_ANGRYなどのビット）
+  uint8_t _beat_lock;     // 何拍でカウンタが一周するか 0なら拍に合わせない
+  unsigned long _last_update_us;  // 前回のupdate()の時刻
+  uint32_t _tick_us;              // 1フレームの長さ(us)
   uint8_t FuryGauge;   // 怒りゲージ (0-255)
   uint8_t ColdGauge;   // 寒いよゲージ (0-255)
   uint8_t HeatGauge;   // 暑いよゲージ (0-255)
@@ -153,6 +313,28 @@ class MoePCB : public Adafruit_NeoPixel {
   bool heat_flag = 0;  // 暑いよモードフラグ　これが１だとゲージが自動で増える
   bool drunk_flag = 0;  // 酔ってるよフラグ　これが１だとゲージが自動で増える
   float morph(float, float, uint8_t);  // モーフィング関数
+  bool layer_alloc(uint8_t);           // レイヤーの領域を確保
+  void layer_select(uint8_t);          // H,S,V...を指定レイヤーに向ける
+  void layer_draw_end(void);           // 描画先レイヤーの描画時間を締める
+  // パターン関数が書き込むLEDを描画先レイヤーに登録
+  // 範囲外のLED番号（領域を確保できずLED数0のときも）ならfalseで、パターンは何も書かない
+  // そのフレームで最初に呼ばれたパターン関数から描画時間を計り始める
+  bool layer_touch(int led_id) {
+    if (_draw_us == 0) _draw_us = micros() | 1;
+    if ((led_id < 0) || (_led_num <= led_id)) return false;
+    _layers[_layer].mask |= (uint32_t)1 << led_id;
+    return true;
+  }
+  uint32_t ease(int);  // 指示値への追従とゲージ処理をしてRGB値を返す
+  void count(void);    // アニメーション用カウンタを進める
+  void brightness_step(uint8_t);  // 明るさを変えてすぐ反映する
+  void led0(bool);        // 背面LEDを点ける・消す　変化したときだけ書き込む
+  void aux_update(void);  // 補助チャンネルを追従させて出力する
+  void power_update(void);  // 送信前のGRB値から電流を見積もり、上限を超えたら暗くする
+  void event_apply(const MoeEvent *);  // ライブラリが扱うイベントを反映する
+  void trace_tick(uint32_t);  // 明るさ・気分の変化とフレームの区切りを記録
 };
 
+extern void MoePCB_Task(void);
+
 #endif
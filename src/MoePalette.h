@@ -0,0 +1,39 @@
+/*!
+ * MoePalette.h - PROGMEMに置いた16色のグラデーションから色を取り出す
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#ifndef MoePalette_h
+#define MoePalette_h
+
+#include "Arduino.h"
+
+#define PALETTE_STOPS 16  // パレットの色数
+
+// 位置(0-255)の使い方
+#define PALETTE_WRAP 0   // 最後の色から最初の色へ戻る（ループするアニメーション用）
+#define PALETTE_CLAMP 1  // 0で最初の色、255で最後の色（lvmeter()などsample()で使う）
+
+// パレットの色　明るさは明るさ設定で決まるので色環と彩度だけ持つ
+struct MoeColor {
+  int16_t h;  // 色環度数（0-359 はみ出してもよい）
+  uint8_t s;  // 彩度(0-255)
+};
+
+// 組み込みのパレット　AUTUMN・FLAME・SKYは最後の色から最初の色へつながる
+// LVMETERはつながらないのでlvmeter()用（gradient()に使うと一周ごとに色が飛ぶ）
+extern const MoeColor PALETTE_AUTUMN[PALETTE_STOPS] PROGMEM;
+extern const MoeColor PALETTE_FLAME[PALETTE_STOPS] PROGMEM;
+extern const MoeColor PALETTE_SKY[PALETTE_STOPS] PROGMEM;
+extern const MoeColor PALETTE_LVMETER[PALETTE_STOPS] PROGMEM;
+
+class MoePalette {
+ public:
+  // パレット、位置(0-255)、PALETTE_WRAP/CLAMP　隣の色との間は1/16刻みで補間する
+  static MoeColor sample(const MoeColor *, uint8_t, uint8_t);
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*!
+ * MoeTempo.cpp - MIDIからテンポを推定する
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "MoeTempo.h"
+
+#include "Arduino.h"
+
+#define TEMPO_MIN_US 333333UL   // 180BPM
+#define TEMPO_MAX_US 1000000UL  // 60BPM
+#define TEMPO_CHORD_US 80000UL  // これより短い間隔のノートオンは和音としてまとめる
+
+MoeTempo::MoeTempo(void) {
+  _beat_us = 500000;  // 120BPM
+  _jitter_us = 0;
+  _confidence = 0;
+  _anchor_us = 0;
+  _anchor_beat = 0;
+  _last_clock_us = 0;
+  _last_event_us = 0;
+  _beat_clock_us = 0;
+  _clock_cnt = 0;
+  _clock_run = false;
+  _start = false;
+  _last_onset_us = 0;
+}
+
+void MoeTempo::midi(uint8_t status, uint8_t data1, uint8_t data2,
+                    unsigned long now) {
+  switch (status) {
+    case 0xF8:  // タイミングクロック 1拍に24回
+      clock(now);
+      break;
+    case 0xFA:  // スタート　次のクロックが1拍目の頭
+      _clock_cnt = 0;
+      _beat_clock_us = 0;
+      _clock_run = false;
+      _start = true;
+      break;
+    case 0xFC:  // ストップ
+      _clock_run = false;
+      break;
+    default:
+      // ノートオン（ベロシティ０はノートオフ扱い）　クロック受信中は使わない
+      if (((status & 0xF0) == 0x90) && (data2 != 0) && !_clock_run) onset(now);
+      (void)data1;
+      break;
+  }
+}
+
+// MIDIクロック
+void MoeTempo::clock(unsigned long now) {
+  if (_clock_run) {
+    // クロック１個ごとの揺れ
+    uint32_t expect = _beat_us / 24;
+    uint32_t diff = now - _last_clock_us;
+    uint32_t err = (diff > expect) ? diff - expect : expect - diff;
+    _jitter_us += ((int32_t)err - (int32_t)_jitter_us) / 8;
+  } else {
+    _beat_clock_us = 0;  // 途切れていた間を1拍の長さとして測らない
+  }
+  if (_clock_cnt == 0) {
+    // 24個（1拍）ぶんの時間で拍の長さを測る
+    if (_beat_clock_us != 0) accept(now - _beat_clock_us, 2);
+    _beat_clock_us = now;
+    if (_start) {
+      // スタート直後は前の拍からの経過で丸めず、ここを0拍目にする
+      _anchor_us = now;
+      _anchor_beat = 0;
+      _start = false;
+    } else {
+      anchor(now);
+    }
+  }
+  _clock_cnt = (_clock_cnt + 1) % 24;
+  _last_clock_us = now;
+  _last_event_us = now;
+  _clock_run = true;
+}
+
+// ノートオンの間隔から拍の長さを推定する
+void MoeTempo::onset(unsigned long now) {
+  uint32_t ioi = now - _last_onset_us;  // 前回のノートオンからの間隔
+  if (ioi < TEMPO_CHORD_US) return;     // 和音
+  _last_onset_us = now;
+  _last_event_us = now;
+  if (TEMPO_MAX_US * 4 < ioi) return;  // 間が空きすぎていたら次から
+
+  // 今の推定値に一番近くなるよう、間隔を整数倍か整数分の１にする（8分音符や2拍など）
+  uint32_t cand;
+  if (ioi < _beat_us) {
+    uint8_t n = constrain((_beat_us + ioi / 2) / ioi, 1, 4);
+    cand = ioi * n;
+  } else {
+    uint8_t n = constrain((ioi + _beat_us / 2) / _beat_us, 1, 4);
+    cand = ioi / n;
+  }
+  uint32_t err = (cand > _beat_us) ? cand - _beat_us : _beat_us - cand;
+
+  if (err < _beat_us / 10) {  // 10%以内なら同じテンポ
+    _jitter_us += ((int32_t)err - (int32_t)_jitter_us) / 8;
+    accept(cand, 3);
+    // 拍の頭付近のノートオンで位相を合わせる
+    uint32_t beat;
+    uint8_t pos;
+    phase(now, &beat, &pos);
+    if ((pos < 40) || (216 < pos)) anchor(now);
+  } else {
+    // 合わなければ信頼度を下げ、信頼できなくなったら測り直す
+    _confidence -= _confidence / 4;
+    if (_confidence < 32) {
+      while ((ioi < TEMPO_MIN_US) && (ioi != 0)) ioi *= 2;
+      while (TEMPO_MAX_US < ioi) ioi /= 2;
+      _beat_us = ioi;
+      _jitter_us = 0;
+      anchor(now);
+    }
+  }
+}
+
+// 拍の長さの候補を反映する　shiftが小さいほど早く追従する
+void MoeTempo::accept(uint32_t beat_us, uint8_t shift) {
+  beat_us = constrain(beat_us, TEMPO_MIN_US / 2, TEMPO_MAX_US * 2);
+  _beat_us += ((int32_t)beat_us - (int32_t)_beat_us) >> shift;
+  if (_confidence < 255) _confidence += (255 - _confidence) / 4 + 1;
+}
+
+// 今を拍の頭にする　拍番号は経過時間から一番近い拍に丸める
+void MoeTempo::anchor(unsigned long now) {
+  uint32_t elapsed = now - _anchor_us;
+  _anchor_beat += (elapsed + _beat_us / 2) / _beat_us;
+  _anchor_us = now;
+}
+
+// 2拍以上MIDIが来なければ信頼度を下げていく（1秒ほどでフリーランに戻る）
+void MoeTempo::tick(unsigned long now) {
+  if ((now - _last_event_us) < _beat_us * 2) return;
+  _clock_run = false;
+  if (0 < _confidence) _confidence -= _confidence / 16 + 1;
+}
+
+void MoeTempo::phase(unsigned long now, uint32_t *beat, uint8_t *pos) {
+  uint32_t elapsed = now - _anchor_us;
+  *beat = _anchor_beat + elapsed / _beat_us;
+  *pos = ((elapsed % _beat_us) << 8) / _beat_us;
+}
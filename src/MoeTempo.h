@@ -0,0 +1,49 @@
+/*!
+ * MoeTempo.h - MIDIからテンポを推定する
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#ifndef MoeTempo_h
+#define MoeTempo_h
+
+#include "Arduino.h"
+
+// MIDIクロック(0xF8)があればそれを、無ければノートオンの間隔から拍の長さを推定する
+class MoeTempo {
+ public:
+  MoeTempo(void);
+
+  // MIDIメッセージ（ステータス、データ1、データ2）と受信時刻(us)
+  void midi(uint8_t, uint8_t, uint8_t, unsigned long);
+  // 毎フレーム呼ぶ　MIDIが途切れたら信頼度を徐々に下げる
+  void tick(unsigned long);
+  // 拍の位相 何拍目か(beat)と拍内の位置(0-255)
+  void phase(unsigned long, uint32_t *, uint8_t *);
+
+  uint32_t Get_beat_us(void) { return _beat_us; }  // 1拍の長さ(us)
+  uint8_t Get_confidence(void) { return _confidence; }  // 信頼度 0-255
+  uint32_t Get_jitter_us(void) { return _jitter_us; }  // 拍の揺れ(us)
+
+ private:
+  uint32_t _beat_us;         // 推定した1拍の長さ
+  uint32_t _jitter_us;       // 推定値とのズレの平均
+  uint8_t _confidence;       // 信頼度 0-255
+  unsigned long _anchor_us;  // 拍の頭の時刻
+  uint32_t _anchor_beat;     // 拍の頭の拍番号
+  unsigned long _last_clock_us;  // 前回のクロックの時刻
+  unsigned long _last_event_us;  // 前回のクロックかノートオンの時刻
+  unsigned long _beat_clock_us;  // クロック24個前（1拍前）の時刻
+  uint8_t _clock_cnt;        // クロックの数 0-23
+  bool _clock_run;           // MIDIクロックを受信中
+  bool _start;               // スタートを受けた　次のクロックを1拍目の頭にする
+  unsigned long _last_onset_us;  // 前回のノートオンの時刻
+  void clock(unsigned long);
+  void onset(unsigned long);
+  void accept(uint32_t, uint8_t);  // 拍の長さの候補を反映
+  void anchor(unsigned long);      // 拍の頭を合わせる
+};
+
+#endif
@@ -0,0 +1,174 @@
+/*!
+ * MoeTimer.cpp - MoePCBの定期実行タイマー
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "MoeTimer.h"
+
+#include "Arduino.h"
+
+extern void MoePCB_Task(void);
+
+// タイマー１・３の割り込みハンドラ（タイマー４はMoePCB.cpp）
+// weakなので、IRremoteなど他のライブラリが同じベクタを定義していればリンク時にそちらが使われる
+ISR(TIMER1_COMPA_vect, __attribute__((weak))) { MoePCB_Task(); }
+ISR(TIMER3_COMPA_vect, __attribute__((weak))) { MoePCB_Task(); }
+
+// デフォルトはタイマー４・50Hz
+MoeTimer::MoeTimer(void) {
+  _timer = MOE_TIMER4;
+  _rate_hz = 50;
+  _claimed = 0;
+  _conflict = 0;
+  _cs = 0;
+  _top = 0;
+  _running = false;
+}
+
+void MoeTimer::select(uint8_t timer, uint8_t rate_hz) {
+  _timer = timer;
+  _rate_hz = rate_hz;
+}
+
+void MoeTimer::claim(uint8_t timer) { _claimed |= MOE_TIMER_BIT(timer); }
+
+void MoeTimer::claim_pin(uint8_t pin) {
+  uint8_t timer = pin_timer(pin);
+  if (timer) claim(timer);
+}
+
+uint8_t MoeTimer::pin_timer(uint8_t pin) {
+  switch (digitalPinToTimer(pin)) {
+    case TIMER1A:
+    case TIMER1B:
+    case TIMER1C:
+      return MOE_TIMER1;
+    case TIMER3A:
+      return MOE_TIMER3;
+    case TIMER4A:
+    case TIMER4D:
+      return MOE_TIMER4;
+    default:
+      return 0;
+  }
+}
+
+// 16MHzでの例
+//   タイマー４ 50Hz：1/2048 → 7812.5カウント/秒 → OCR4C=155 (0-255)
+//   タイマー１ 50Hz：1/8    → 2000000カウント/秒 → OCR1A=39999 (16bit)
+bool MoeTimer::calc(uint8_t timer, uint16_t rate_hz, uint8_t *cs,
+                    uint16_t *top) {
+  if (rate_hz == 0) return false;
+  if (timer == MOE_TIMER4) {
+    // タイマー４は1/1〜1/16384までの2のべき乗、コンペアは8bit
+    for (uint8_t c = 1; c <= 15; c++) {
+      uint32_t count = ((F_CPU >> (c - 1)) + rate_hz / 2) / rate_hz;
+      if ((1 < count) && (count <= 256)) {
+        *cs = c;
+        *top = count - 1;
+        return true;
+      }
+    }
+  } else if ((timer == MOE_TIMER1) || (timer == MOE_TIMER3)) {
+    // タイマー１・３は1/1,1/8,1/64,1/256,1/1024、コンペアは16bit
+    const uint8_t shift[5] = {0, 3, 6, 8, 10};
+    for (uint8_t c = 1; c <= 5; c++) {
+      uint32_t count = ((F_CPU >> shift[c - 1]) + rate_hz / 2) / rate_hz;
+      if ((1 < count) && (count <= 65536)) {
+        *cs = c;
+        *top = count - 1;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// 宣言されたタイマーと、既に割り込みが有効になっているタイマーは使用中
+uint8_t MoeTimer::busy(void) {
+  uint8_t mask = _claimed;
+  if (TIMSK1) mask |= MOE_TIMER_BIT(MOE_TIMER1);
+  if (TIMSK3) mask |= MOE_TIMER_BIT(MOE_TIMER3);
+  if (TIMSK4) mask |= MOE_TIMER_BIT(MOE_TIMER4);
+  if (_running) mask &= ~MOE_TIMER_BIT(_timer);  // 自分が使っている分は除く
+  return mask;
+}
+
+bool MoeTimer::begin(void) {
+  _conflict = busy() & MOE_TIMER_BIT(_timer);
+  if (_conflict) return false;
+  if (!calc(_timer, _rate_hz, &_cs, &_top)) return false;
+
+  uint8_t oldSREG = SREG;
+  cli();
+  if (_timer == MOE_TIMER4) {
+    TCCR4B = 0;
+    TCCR4A = 0;
+    TCCR4C = 0;
+    TCCR4D = 0;
+    TCCR4E = 0;
+    TCCR4B = _cs;
+    OCR4C = _top;  // TOP値　OCR4Aの0でコンペアAが毎周期一致する
+    TIFR4 = (1 << OCF4A);
+    TCNT4 = 0;
+    TIMSK4 = (1 << OCIE4A);
+  } else if (_timer == MOE_TIMER1) {
+    TCCR1B = 0;
+    TCCR1A = 0;
+    TCCR1C = 0;
+    TCCR1B = (1 << WGM12) | _cs;  // CTCモード
+    OCR1A = _top;
+    TIFR1 = (1 << OCF1A);
+    TCNT1 = 0;
+    TIMSK1 = (1 << OCIE1A);
+  } else if (_timer == MOE_TIMER3) {
+    TCCR3B = 0;
+    TCCR3A = 0;
+    TCCR3C = 0;
+    TCCR3B = (1 << WGM32) | _cs;  // CTCモード
+    OCR3A = _top;
+    TIFR3 = (1 << OCF3A);
+    TCNT3 = 0;
+    TIMSK3 = (1 << OCIE3A);
+  }
+  SREG = oldSREG;
+  _running = true;
+  return true;
+}
+
+void MoeTimer::stop(void) {
+  pause();
+  _running = false;
+}
+
+void MoeTimer::pause(void) {
+  if (!_running) return;
+  if (_timer == MOE_TIMER4) TIMSK4 &= ~(1 << OCIE4A);
+  if (_timer == MOE_TIMER1) TIMSK1 &= ~(1 << OCIE1A);
+  if (_timer == MOE_TIMER3) TIMSK3 &= ~(1 << OCIE3A);
+}
+
+void MoeTimer::resume(void) {
+  if (!_running) return;
+  if (_timer == MOE_TIMER4) TIMSK4 |= (1 << OCIE4A);
+  if (_timer == MOE_TIMER1) TIMSK1 |= (1 << OCIE1A);
+  if (_timer == MOE_TIMER3) TIMSK3 |= (1 << OCIE3A);
+}
+
+// 書き込んだ設定が残っているか　IrReceiver.begin()などの後に呼ぶと上書きを検出できる
+bool MoeTimer::check(void) {
+  if (!_running) return true;
+  bool ok = true;
+  if (_timer == MOE_TIMER4)
+    ok = (TCCR4B == _cs) && (OCR4C == _top) && (TIMSK4 & (1 << OCIE4A));
+  if (_timer == MOE_TIMER1)
+    ok = (TCCR1B == ((1 << WGM12) | _cs)) && (OCR1A == _top) &&
+         (TIMSK1 & (1 << OCIE1A));
+  if (_timer == MOE_TIMER3)
+    ok = (TCCR3B == ((1 << WGM32) | _cs)) && (OCR3A == _top) &&
+         (TIMSK3 & (1 << OCIE3A));
+  if (!ok) _conflict |= MOE_TIMER_BIT(_timer);
+  return ok;
+}
@@ -0,0 +1,60 @@
+/*!
+ * MoeTimer.h - MoePCBの定期実行タイマー
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#ifndef MoeTimer_h
+#define MoeTimer_h
+
+#include "Arduino.h"
+
+// 定期実行に使えるタイマー（ATmega32U4）
+#define MOE_TIMER1 1  // 16bit  analogWrite()のD9,D10と共用
+#define MOE_TIMER3 3  // 16bit  IRremoteの受信がLeonardoで使う
+#define MOE_TIMER4 4  // 10bit高速タイマー  analogWrite()のD6,D13と共用（デフォルト）
+#define MOE_TIMER_BIT(t) (1 << (t))
+
+class MoeTimer {
+ public:
+  MoeTimer(void);
+
+  // 使うタイマーと割り込み周期(Hz)を選ぶ　begin()より前に呼ぶ
+  void select(uint8_t, uint8_t);
+  // 他のライブラリが使っているタイマーを宣言する（MOE_TIMERn）
+  void claim(uint8_t);
+  // analogWrite()するピンを宣言する　そのピンのタイマーを使用中にする
+  void claim_pin(uint8_t);
+  // タイマー開始　競合していたら開始せずfalse
+  bool begin(void);
+  void stop(void);
+  void pause(void);   // 割り込みだけ一時停止
+  void resume(void);  // 割り込み再開
+  // 開始後に他のライブラリにレジスタを書き換えられていないか確認する
+  bool check(void);
+
+  uint8_t Get_timer(void) { return _timer; }
+  uint8_t Get_conflict(void) { return _conflict; }  // 競合したタイマーのビット
+  uint8_t Get_cs(void) { return _cs; }    // クロック選択ビット
+  uint16_t Get_top(void) { return _top; }  // コンペア値
+
+  // 周期からクロック選択ビットとコンペア値を計算する　作れない周期ならfalse
+  static bool calc(uint8_t timer, uint16_t rate_hz, uint8_t *cs,
+                   uint16_t *top);
+  // ピンのPWMを担当しているタイマー（MOE_TIMERn）無ければ0
+  static uint8_t pin_timer(uint8_t pin);
+
+ private:
+  uint8_t _timer;     // 使うタイマー
+  uint8_t _rate_hz;   // 割り込み周期
+  uint8_t _claimed;   // 他のライブラリが使っているタイマーのビット
+  uint8_t _conflict;  // 競合したタイマーのビット
+  uint8_t _cs;        // クロック選択ビット
+  uint16_t _top;      // コンペア値
+  bool _running;
+  uint8_t busy(void);  // 他が使っているタイマーのビット
+};
+
+#endif
@@ -0,0 +1,93 @@
+/*!
+ * MoeTrace.cpp - 入力を記録して後からPC上で再生するためのトレース
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+#include "MoeTrace.h"
+
+#include "Arduino.h"
+
+MoeTrace::MoeTrace(void) {
+  _buf = NULL;
+  _size = 0;
+  _head = 0;
+  _tail = 0;
+  _used = 0;
+  _ticks = 0;
+  _wrapped = false;
+  _led_num = 0;
+  _seed = 0;
+}
+
+bool MoeTrace::begin(uint16_t size, uint8_t led_num, uint32_t seed) {
+  end();
+  if (size < TRACE_EVENT_SIZE) return false;
+  _buf = (uint8_t *)malloc(size);
+  if (_buf == NULL) return false;
+  _size = size;
+  _led_num = led_num;
+  _seed = seed;
+  return true;
+}
+
+void MoeTrace::end(void) {
+  free(_buf);
+  _buf = NULL;
+  _size = 0;
+  _head = 0;
+  _tail = 0;
+  _used = 0;
+  _ticks = 0;
+  _wrapped = false;
+}
+
+void MoeTrace::tick(uint32_t dt_us) {
+  uint32_t ms = (dt_us + 500) / 1000;
+  uint8_t rec = TRACE_TICK | (uint8_t)constrain(ms, 1, 127);
+  put(&rec, 1);
+  _ticks++;
+}
+
+void MoeTrace::event(uint8_t type, uint8_t d0, uint8_t d1, uint8_t d2,
+                     uint8_t age) {
+  uint8_t rec[TRACE_EVENT_SIZE] = {type, d0, d1, d2, age};
+  put(rec, TRACE_EVENT_SIZE);
+}
+
+void MoeTrace::put(const uint8_t *rec, uint8_t len) {
+  if (_buf == NULL) return;
+  // 空きが足りなければ一番古い記録を丸ごと捨てる（記録の途中から始まらないように）
+  while (_size - _used < len) {
+    uint8_t old = (_buf[_tail] & TRACE_TICK) ? 1 : TRACE_EVENT_SIZE;
+    _tail = (_tail + old) % _size;
+    _used -= old;
+    _wrapped = true;
+  }
+  for (uint8_t i = 0; i < len; i++) {
+    _buf[_head] = rec[i];
+    if (++_head == _size) _head = 0;
+  }
+  _used += len;
+}
+
+void MoeTrace::dump(Print &out) {
+  uint8_t header[TRACE_HEADER_SIZE] = {
+      'M',
+      'T',
+      TRACE_VERSION,
+      (uint8_t)(_wrapped ? TRACE_FLAG_WRAPPED : 0),
+      _led_num,
+      0,
+      (uint8_t)_seed,
+      (uint8_t)(_seed >> 8),
+      (uint8_t)(_seed >> 16),
+      (uint8_t)(_seed >> 24)};
+  out.write(header, TRACE_HEADER_SIZE);
+  uint16_t p = _tail;
+  for (uint16_t i = 0; i < _used; i++) {
+    out.write(_buf[p]);
+    if (++p == _size) p = 0;
+  }
+}
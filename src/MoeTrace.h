@@ -0,0 +1,58 @@
+/*!
+ * MoeTrace.h - 入力を記録して後からPC上で再生するためのトレース
+ *
+ * 記録の形式（リトルエンディアン）
+ *   ヘッダー TRACE_HEADER_SIZEバイト
+ *     'M' 'T' バージョン フラグ LED数 0 乱数の種(4バイト)
+ *   以降は記録の並び
+ *     ティック  １バイト 0x80|前回のupdate()からの間隔(ms 1-127)
+ *     イベント  ５バイト 種類(EV_TOUCHなど) データ0-2 読み出すまでの待ち時間(128us単位)
+ *   ティックの前に並んだイベントはそのティックのupdate()までに読み出されたもの
+ * 再生はextras/replayで行う
+ *
+ * Copyright (c) 2023 Mizuhasi Yukkie
+ * Released under the MIT license.
+ * see https://opensource.org/licenses/MIT
+ */
+
+#ifndef MoeTrace_h
+#define MoeTrace_h
+
+#include "Arduino.h"
+
+#define TRACE_VERSION 1
+#define TRACE_HEADER_SIZE 10
+#define TRACE_EVENT_SIZE 5
+#define TRACE_TICK 0x80        // 最上位ビットが立っていればティックの記録
+#define TRACE_FLAG_WRAPPED 1   // リングが一周して古い記録を捨てた
+
+// 記録はリングバッファに貯め、満杯になったら古い記録から１件ずつ捨てる
+// 記録はタイマー側（MoePCB_Task()とupdate()）だけが行う前提
+class MoeTrace {
+ public:
+  MoeTrace(void);
+  bool begin(uint16_t, uint8_t, uint32_t);  // バッファのバイト数、LED数、乱数の種
+  void end(void);                           // 記録をやめて領域を解放
+  bool active(void) { return _buf != NULL; }
+  void tick(uint32_t);  // 前回のティックからの間隔(us)
+  void event(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t);  // 種類、データ0-2、待ち時間
+  void dump(Print &);   // ヘッダーと記録を古い順に書き出す
+  uint16_t Get_used(void) { return _used; }  // 記録済みのバイト数（ヘッダー除く）
+  uint32_t Get_ticks(void) { return _ticks; }
+  bool Get_wrapped(void) { return _wrapped; }
+
+ private:
+  void put(const uint8_t *, uint8_t);
+
+  uint8_t *_buf;    // 記録領域（未開始ならNULL）
+  uint16_t _size;   // 記録領域のバイト数
+  uint16_t _head;   // 次に書く位置
+  uint16_t _tail;   // 一番古い記録の位置
+  uint16_t _used;   // 記録済みのバイト数
+  uint32_t _ticks;  // 記録したティック数（捨てた分も含む）
+  bool _wrapped;
+  uint8_t _led_num;
+  uint32_t _seed;
+};
+
+#endif